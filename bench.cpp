@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "modarith.h"
+#include "primality.h"
+#include "kernels.h"
+#include "sieve.h"
+#include "wheel.h"
+
+// microbenchmarks for the arithmetic kernels
+// every benchmark runs two warm-up passes, then --reps timed passes over
+// a fixed operand set, and reports ns per operation (median, mean, stddev,
+// min) as JSON; --baseline compares medians against an earlier run and
+// exits with status 1 when one got slower than --threshold percent
+
+struct Result {
+    std::string name;
+    uint64_t ops;
+    int reps;
+    double median, mean, stddev, min;
+};
+
+volatile uint64_t sink; // keeps results alive
+
+template <typename F>
+Result run(const std::string& name, uint64_t ops, int reps, F body){
+    body();
+    body();
+
+    std::vector<double> ns;
+    for (int r = 0; r < reps; ++r) {
+        auto t0 = std::chrono::steady_clock::now();
+        body();
+        auto t1 = std::chrono::steady_clock::now();
+        ns.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count() / ops);
+    }
+    std::sort(ns.begin(), ns.end());
+
+    Result res = {name, ops, reps, 0, 0, 0, ns.front()};
+    res.median = reps % 2 ? ns[reps / 2] : (ns[reps / 2 - 1] + ns[reps / 2]) / 2;
+    for (double x : ns) res.mean += x;
+    res.mean /= reps;
+    for (double x : ns) res.stddev += (x - res.mean) * (x - res.mean);
+    res.stddev = reps > 1 ? std::sqrt(res.stddev / (reps - 1)) : 0;
+    return res;
+}
+
+// count odd operands starting at base, walking down when base is near 2^64
+std::vector<uint64_t> odd_operands(uint64_t base, size_t count){
+    std::vector<uint64_t> v;
+    for (size_t i = 0; i < count; ++i) {
+        v.push_back(base > UINT64_MAX / 2 ? (base | 1) - 2 * i : (base | 1) + 2 * i);
+    }
+    return v;
+}
+
+std::vector<uint64_t> prime_operands(uint64_t base, size_t count){
+    std::vector<uint64_t> v;
+    for (uint64_t n : odd_operands(base, 64 * count)) {
+        if (verify(n).prime) v.push_back(n);
+        if (v.size() == count) break;
+    }
+    return v;
+}
+
+std::string to_json(const std::vector<Result>& results){
+    std::ostringstream out;
+    out << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"ops\": " << r.ops << ", \"reps\": " << r.reps
+            << ", \"median_ns\": " << r.median << ", \"mean_ns\": " << r.mean
+            << ", \"stddev_ns\": " << r.stddev << ", \"min_ns\": " << r.min << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return out.str();
+}
+
+// reads name -> median_ns back from a file written by to_json
+std::map<std::string, double> read_baseline(const std::string& path){
+    std::map<std::string, double> medians;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t n = line.find("\"name\": \"");
+        size_t m = line.find("\"median_ns\": ");
+        if (n == std::string::npos || m == std::string::npos) continue;
+        n += 9;
+        std::string name = line.substr(n, line.find('"', n) - n);
+        medians[name] = std::stod(line.substr(m + 13));
+    }
+    return medians;
+}
+
+int main(int argc, char* argv[]){
+    int reps = 15;
+    std::string out_path, baseline_path, filter;
+    double threshold = 5.0; // percent
+
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (arg == "--reps" && a + 1 < argc) reps = std::max(1, std::stoi(argv[++a]));
+        else if (arg == "--out" && a + 1 < argc) out_path = argv[++a];
+        else if (arg == "--baseline" && a + 1 < argc) baseline_path = argv[++a];
+        else if (arg == "--threshold" && a + 1 < argc) threshold = std::stod(argv[++a]);
+        else if (arg == "--filter" && a + 1 < argc) filter = argv[++a];
+        else {
+            std::cout << "usage: " << argv[0] << " [--reps N] [--out FILE] [--baseline FILE] [--threshold PCT] [--filter SUBSTR]" << std::endl;
+            return 1;
+        }
+    }
+
+    const std::pair<const char*, uint64_t> sizes[] = {
+        {"2^32", 1ULL << 32},
+        {"2^48", 1ULL << 48},
+        {"2^63", 1ULL << 63},
+        {"2^64", UINT64_MAX},
+    };
+    const size_t count = 2048;
+    CongruenceSieve sieve(1 << 16);
+    std::vector<Result> results;
+    auto wanted = [&](const std::string& name) { return filter.empty() || name.find(filter) != std::string::npos; };
+
+    for (const auto& size : sizes) {
+        std::string tag = std::string("/") + size.first;
+        std::vector<uint64_t> odd = odd_operands(size.second, count);
+        std::vector<uint64_t> primes = prime_operands(size.second, count / 8);
+
+        if (wanted("bin_exp" + tag)) results.push_back(run("bin_exp" + tag, count, reps, [&] {
+            uint64_t s = 0;
+            for (uint64_t n : odd) s += bin_exp(2, n - 1, n);
+            sink = s;
+        }));
+        if (wanted("fermat2_batch" + tag)) results.push_back(run("fermat2_batch" + tag, count, reps, [&] {
+            uint64_t s = 0;
+            for (size_t i = 0; i < count; i += 16) s += fermat2_batch(odd.data() + i, 16);
+            sink = s;
+        }));
+        if (wanted("fast_fib" + tag)) results.push_back(run("fast_fib" + tag, count, reps, [&] {
+            uint64_t s = 0;
+            for (uint64_t n : odd) s += fast_fib(n + 1, n);
+            sink = s;
+        }));
+        if (wanted("lucas_fib" + tag)) results.push_back(run("lucas_fib" + tag, count, reps, [&] {
+            uint64_t s = 0;
+            for (uint64_t n : odd) s += lucas_fib(Montgomery(n), n + 1);
+            sink = s;
+        }));
+        if (wanted("fib_batch" + tag)) results.push_back(run("fib_batch" + tag, count, reps, [&] {
+            uint64_t s = 0;
+            for (size_t i = 0; i < count; i += 64) s += fib_batch(odd.data() + i, 64);
+            sink = s;
+        }));
+        if (wanted("verify" + tag)) results.push_back(run("verify" + tag, primes.size(), reps, [&] {
+            uint64_t s = 0;
+            for (uint64_t n : primes) s += verify(n).prime;
+            sink = s;
+        }));
+        if (wanted("isqrt" + tag)) results.push_back(run("isqrt" + tag, count, reps, [&] {
+            uint64_t s = 0;
+            for (uint64_t n : odd) s += isqrt(n);
+            sink = s;
+        }));
+
+        // the worker's inner loop: sieve a chunk, batch Fermat, Lucas on survivors
+        // reported per number of the range
+        const uint64_t width = 1 << 14;
+        uint64_t lo = size.second > UINT64_MAX / 2 ? size.second - width : size.second;
+        if (wanted("candidate_loop" + tag)) results.push_back(run("candidate_loop" + tag, width, reps, [&] {
+            wheel::Iterator<uint64_t> w(lo);
+            std::vector<uint8_t> keep(width / 2);
+            sieve.sieve(lo | 1, width / 2, keep.data());
+            uint64_t cand[256], batch[16], s = 0;
+            size_t k = 0;
+            auto flush = [&] {
+                uint64_t pass = fermat2_batch(batch, k);
+                for (; pass; pass &= pass - 1) {
+                    uint64_t c = batch[__builtin_ctzll(pass)];
+                    s += lucas_fib(Montgomery(c), c + 1);
+                }
+                k = 0;
+            };
+            while (size_t m = w.fill(cand, 256, lo + width)) {
+                for (size_t i = 0; i < m; ++i) {
+                    uint64_t n = cand[i];
+                    if (keep[(n - (lo | 1)) / 2]) batch[k++] = n;
+                    if (k == 16) flush();
+                }
+            }
+            // the last survivors of the pass, fewer than 16
+            if (k) flush();
+            sink = s;
+        }));
+    }
+
+    // two-limb kernels past 2^64
+    const std::pair<const char*, int> wide_sizes[] = {{"2^65", 64}, {"2^96", 95}, {"2^127", 126}};
+    for (const auto& size : wide_sizes) {
+        std::string tag = std::string("/") + size.first;
+        std::vector<uint128_t> odd;
+        for (uint64_t n : odd_operands(0x9e3779b97f4a7c15ULL, count)) odd.push_back(static_cast<uint128_t>(1) << size.second | n);
+
+        if (wanted("bin_exp128" + tag)) results.push_back(run("bin_exp128" + tag, count, reps, [&] {
+            uint64_t s = 0;
+            for (uint128_t n : odd) s += static_cast<uint64_t>(bin_exp(Montgomery128(n), 2, n - 1));
+            sink = s;
+        }));
+        if (wanted("fermat2_batch128" + tag)) results.push_back(run("fermat2_batch128" + tag, count, reps, [&] {
+            uint64_t s = 0;
+            for (size_t i = 0; i < count; i += 64) s += fermat2_batch(odd.data() + i, 64);
+            sink = s;
+        }));
+        if (wanted("lucas_fib128" + tag)) results.push_back(run("lucas_fib128" + tag, count, reps, [&] {
+            uint64_t s = 0;
+            for (uint128_t n : odd) s += static_cast<uint64_t>(lucas_fib(Montgomery128(n), n + 1));
+            sink = s;
+        }));
+    }
+
+    std::string json = to_json(results);
+    if (out_path.empty()) std::cout << json;
+    else {
+        std::ofstream(out_path) << json;
+        std::cout << "wrote " << results.size() << " results to " << out_path << std::endl;
+    }
+
+    if (baseline_path.empty()) return 0;
+    std::map<std::string, double> baseline = read_baseline(baseline_path);
+    if (baseline.empty()) {
+        std::cout << "no results in baseline " << baseline_path << std::endl;
+        return 1;
+    }
+    int regressions = 0;
+    for (const Result& r : results) {
+        auto it = baseline.find(r.name);
+        if (it == baseline.end() || it->second <= 0) continue;
+        double change = (r.median - it->second) / it->second * 100.0;
+        bool slower = change > threshold;
+        regressions += slower;
+        std::cout << (slower ? "REGRESSION " : "           ") << r.name << ": "
+                  << it->second << " -> " << r.median << " ns (" << (change >= 0 ? "+" : "") << change << "%)" << std::endl;
+    }
+    return regressions > 0 ? 1 : 0;
+}
+
+// LINUX COMPILE:
+// g++ bench.cpp -o bench -O3 -march=native
+
+// usage:
+// ./bench --out baseline.json
+// ./bench --baseline baseline.json --threshold 5
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "modarith.h"
+#include "psplist.h"
+
+// append-only catalogue of every number of a searched range that passes
+// the Fermat test, with what the Fibonacci test and verify() made of them,
+// so a new secondary test can be run over the survivors of a range without
+// redoing the sweep; the search only covers odd n == ±2 mod 5, and with a
+// catalogue its sieve keeps to the Fermat condition and the primes the
+// prime map drops are listed as passing both, so within those residues
+// the list is complete
+//
+//   magic "PSWCAT02"
+//   blocks, each one flush of one worker:
+//     header  first, last (two words each), entry count, payload bytes,
+//             crc32 of the fields before it and the payload
+//     payload per entry (delta to the previous value << 2 | flags) as a
+//             LEB128 varint, the first entry's delta is 0
+//
+// blocks come in the order workers finish their ranges, so the reader
+// sorts them by value; a range re-run after a crash shows up twice and is
+// merged; a torn block at the end is ignored by the reader and cut off by
+// the next writer (catalogues from before the crc covered the header,
+// PSWCAT01, are refused)
+
+namespace catalogue {
+
+const char magic[8] = {'P', 'S', 'W', 'C', 'A', 'T', '0', '2'};
+
+const uint8_t fib_pass = 1;  // F(n+1) == 0 mod n as well
+const uint8_t prime = 2;     // verify() or the prime map proved it, only set with fib_pass
+
+const uint32_t max_block = 1 << 16;
+
+struct Entry {
+    uint128_t n;
+    uint8_t flags;
+};
+
+struct BlockHeader {
+    uint64_t first_lo, first_hi, last_lo, last_hi;
+    uint32_t count;
+    uint32_t bytes;
+    uint32_t crc;
+    uint32_t reserved;
+};
+
+// crc32 of the header fields before crc, then of the payload
+inline uint32_t block_crc(const BlockHeader& h, const uint8_t* payload){
+    return psplist::crc32(payload, h.bytes, psplist::crc32(reinterpret_cast<const uint8_t*>(&h), offsetof(BlockHeader, crc)));
+}
+
+inline uint128_t wide(uint64_t lo, uint64_t hi){
+    return static_cast<uint128_t>(hi) << 64 | lo;
+}
+
+// appends entries [0, count) as blocks, starting a new one when a block
+// is full or a delta would not fit next to the flags
+inline void encode(const Entry* e, size_t count, std::vector<uint8_t>& out){
+    size_t i = 0;
+    while (i < count) {
+        size_t head = out.size();
+        out.resize(head + sizeof(BlockHeader));
+        size_t j = i;
+        for (; j < count && j - i < max_block; ++j) {
+            uint128_t delta = j == i ? 0 : e[j].n - e[j - 1].n;
+            if (delta >= (static_cast<uint128_t>(1) << 62)) break;
+            psplist::put_varint(out, static_cast<uint64_t>(delta) << 2 | (e[j].flags & 3));
+        }
+        BlockHeader h = {static_cast<uint64_t>(e[i].n), static_cast<uint64_t>(e[i].n >> 64),
+                         static_cast<uint64_t>(e[j - 1].n), static_cast<uint64_t>(e[j - 1].n >> 64),
+                         static_cast<uint32_t>(j - i), static_cast<uint32_t>(out.size() - head - sizeof(BlockHeader)), 0, 0};
+        h.crc = block_crc(h, out.data() + head + sizeof(BlockHeader));
+        memcpy(out.data() + head, &h, sizeof(h));
+        i = j;
+    }
+}
+
+// length of the intact prefix of a catalogue image, 0 when the magic is wrong
+inline size_t valid_length(const uint8_t* base, size_t length){
+    if (length < sizeof(magic) || memcmp(base, magic, sizeof(magic)) != 0) return 0;
+    size_t pos = sizeof(magic);
+    while (length - pos >= sizeof(BlockHeader)) {
+        BlockHeader h;
+        memcpy(&h, base + pos, sizeof(h));
+        // only the length is trusted here, a damaged header fails its
+        // block's crc in the reader instead of cutting the file short
+        if (h.bytes > length - pos - sizeof(h)) break;
+        pos += sizeof(h) + h.bytes;
+    }
+    return pos;
+}
+
+// shared by all workers of a process, each flushes its own buffer
+class Writer {
+private:
+    int fd = -1;
+    std::mutex lock;
+    uint64_t entries = 0;
+
+public:
+    Writer() {}
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+    ~Writer() { if (fd >= 0) close(fd); }
+
+    // creates the file or continues an existing one past its last whole block
+    bool open(const std::string& path) {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) return false;
+        size_t end = sizeof(magic);
+        if (st.st_size == 0) {
+            if (!write_all(magic, sizeof(magic))) return false;
+        } else {
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED) return false;
+            end = valid_length(static_cast<const uint8_t*>(p), st.st_size);
+            munmap(p, st.st_size);
+            if (end == 0 || ftruncate(fd, end) != 0) return false;
+        }
+        return lseek(fd, end, SEEK_SET) == static_cast<off_t>(end);
+    }
+
+    // entries in increasing order, the buffer of one worker
+    bool append(const std::vector<Entry>& e) {
+        if (e.empty()) return true;
+        std::vector<uint8_t> out;
+        encode(e.data(), e.size(), out);
+        std::lock_guard<std::mutex> guard(lock);
+        entries += e.size();
+        return write_all(out.data(), out.size());
+    }
+
+    // everything appended so far reaches the disk, called before a
+    // checkpoint marks those ranges done
+    bool sync() { return fdatasync(fd) == 0; }
+
+    uint64_t appended() const { return entries; }
+
+private:
+    bool write_all(const void* data, size_t len) {
+        const char* p = static_cast<const char*>(data);
+        while (len > 0) {
+            ssize_t w = write(fd, p, len);
+            if (w < 0) return false;
+            p += w;
+            len -= static_cast<size_t>(w);
+        }
+        return true;
+    }
+};
+
+// read-only view through mmap, blocks indexed by value on open
+class Reader {
+private:
+    struct Block {
+        uint128_t first, last;
+        size_t offset;   // of the payload
+        BlockHeader header;
+    };
+
+    const uint8_t* base = nullptr;
+    size_t length = 0;
+    std::vector<Block> index;
+    uint64_t total = 0;
+
+public:
+    Reader() {}
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+    ~Reader() { if (base) munmap(const_cast<uint8_t*>(base), length); }
+
+    bool open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(magic)) {
+            close(fd);
+            return false;
+        }
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) return false;
+        base = static_cast<const uint8_t*>(p);
+        length = st.st_size;
+
+        size_t end = valid_length(base, length);
+        if (end == 0) return false;
+        for (size_t pos = sizeof(magic); pos < end; ) {
+            Block b;
+            memcpy(&b.header, base + pos, sizeof(BlockHeader));
+            b.first = wide(b.header.first_lo, b.header.first_hi);
+            b.last = wide(b.header.last_lo, b.header.last_hi);
+            b.offset = pos + sizeof(BlockHeader);
+            if (b.header.count > 0) {
+                index.push_back(b);
+                total += b.header.count;
+            }
+            pos = b.offset + b.header.bytes;
+        }
+        std::sort(index.begin(), index.end(), [](const Block& a, const Block& b) { return a.first < b.first; });
+        return true;
+    }
+
+    uint64_t blocks() const { return index.size(); }
+    uint64_t entries() const { return total; }  // counting a re-run range twice
+
+    // decodes block b, false when its checksum does not match
+    bool decode(size_t b, std::vector<Entry>& out) const {
+        const Block& blk = index[b];
+        const uint8_t* p = base + blk.offset;
+        const uint8_t* end = p + blk.header.bytes;
+        // every entry takes a byte at least
+        if (blk.header.count > blk.header.bytes || block_crc(blk.header, p) != blk.header.crc) return false;
+        uint128_t v = blk.first;
+        for (uint32_t i = 0; i < blk.header.count; ++i) {
+            uint64_t x;
+            if (!psplist::get_varint(p, end, x)) return false;
+            v += x >> 2;
+            out.push_back({v, static_cast<uint8_t>(x & 3)});
+        }
+        return p == end && v == blk.last;
+    }
+
+    // calls fn(entry) for the entries in [lo, hi) in increasing order,
+    // each value once; false when a damaged block had to be skipped
+    template <typename F>
+    bool for_each(uint128_t lo, uint128_t hi, F fn) const {
+        bool intact = true;
+        std::vector<Entry> group;
+        size_t b = 0;
+        while (b < index.size() && index[b].first < hi) {
+            // blocks overlapping each other are merged, normally just one
+            uint128_t reach = index[b].last;
+            size_t e = b + 1;
+            while (e < index.size() && index[e].first <= reach) reach = std::max(reach, index[e++].last);
+            if (reach >= lo) {
+                group.clear();
+                for (size_t i = b; i < e; ++i) intact = decode(i, group) && intact;
+                if (e - b > 1) {
+                    std::sort(group.begin(), group.end(), [](const Entry& x, const Entry& y) { return x.n < y.n; });
+                    group.erase(std::unique(group.begin(), group.end(), [](const Entry& x, const Entry& y) { return x.n == y.n; }), group.end());
+                }
+                for (const Entry& x : group) {
+                    if (x.n >= lo && x.n < hi) fn(x);
+                }
+            }
+            b = e;
+        }
+        return intact;
+    }
+};
+
+} // namespace catalogue
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "modarith.h"
+
+// crash-safe record of the search frontier: blocks [0, frontier) are all
+// complete and bit i of done marks block frontier + i as finished out of
+// order, everything else was in flight and gets re-tested on resume
+// the file is replaced atomically (write tmp, fsync, rename, fsync dir) so
+// a crash at any point leaves either the old or the new checkpoint
+// start and end are stored as two words each for searches past 2^64
+// version 3 marks checkpoints of the wheel generator; versions 1 and 2 were
+// written while the workers walked the wrong residues mod 10, so the blocks
+// they mark done were never searched for real and they are refused
+
+struct Checkpoint {
+    uint128_t start = 0, end = 0;  // scheduler geometry, must match on resume
+    uint64_t width = 0;
+    uint64_t frontier = 0;
+    std::vector<uint8_t> done;
+};
+
+namespace checkpoint_detail {
+
+const char magic[8] = {'P', 'S', 'W', 'C', 'K', 'P', 'T', '3'};
+
+inline bool write_all(int fd, const void* data, size_t len){
+    const char* p = static_cast<const char*>(data);
+    while (len > 0) {
+        ssize_t w = write(fd, p, len);
+        if (w < 0) return false;
+        p += w;
+        len -= static_cast<size_t>(w);
+    }
+    return true;
+}
+
+inline std::string dir_of(const std::string& path){
+    size_t slash = path.rfind('/');
+    if (slash == std::string::npos) return ".";
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+} // namespace checkpoint_detail
+
+inline bool write_checkpoint(const std::string& path, const Checkpoint& c){
+    using namespace checkpoint_detail;
+    std::string tmp = path + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+
+    uint64_t header[7] = {static_cast<uint64_t>(c.start), static_cast<uint64_t>(c.start >> 64),
+                          static_cast<uint64_t>(c.end), static_cast<uint64_t>(c.end >> 64),
+                          c.width, c.frontier, c.done.size()};
+    bool ok = write_all(fd, magic, sizeof(magic))
+           && write_all(fd, header, sizeof(header))
+           && write_all(fd, c.done.data(), c.done.size())
+           && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    // make the rename itself durable
+    int dfd = open(dir_of(path).c_str(), O_RDONLY | O_DIRECTORY);
+    if (dfd >= 0) {
+        fsync(dfd);
+        close(dfd);
+    }
+    return true;
+}
+
+inline bool read_checkpoint(const std::string& path, Checkpoint& c){
+    using namespace checkpoint_detail;
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+
+    char m[8];
+    uint64_t header[7] = {0};
+    bool ok = fread(m, 1, sizeof(m), f) == sizeof(m)
+           && memcmp(m, magic, sizeof(m)) == 0
+           && fread(header, sizeof(uint64_t), 7, f) == 7;
+    ok = ok && header[6] <= (1 << 20);
+    if (ok) {
+        c.start = static_cast<uint128_t>(header[1]) << 64 | header[0];
+        c.end = static_cast<uint128_t>(header[3]) << 64 | header[2];
+        c.width = header[4];
+        c.frontier = header[5];
+        c.done.resize(header[6]);
+        ok = fread(c.done.data(), 1, c.done.size(), f) == c.done.size();
+    }
+    fclose(f);
+    return ok;
+}
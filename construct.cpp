@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "modarith.h"
+#include "primality.h"
+#include "kernels.h"
+#include "construct.h"
+
+// structured search: builds products of primes that pass both PSW
+// conditions by construction (see construct.h) instead of scanning, so it
+// reaches sizes up to 2^128 that a scan never will; every product goes
+// through the Fermat and Fibonacci kernels before it is reported, which
+// double-checks the construction
+//
+// L and K take a product like 2*3^3*7*11*13*19*37; the more divisors they
+// have the more primes qualify, but a product below the bound must be at
+// least as large as L and K, so each has to stay well below it
+//
+// with --fermat-only (K = 2) the products are base-2 pseudoprimes == ±2
+// mod 5, each printed; they fail the Fibonacci test, so they check the
+// construction and the kernels where the full search has nothing to show
+
+std::mutex print_lock;
+std::atomic_uint64_t next_task(0), tasks_done(0), walked(0), products(0), kernel_failures(0), found(0);
+std::atomic_uint64_t pseudoprimes(0);
+bool fib_side = true;   // false with --fermat-only
+
+// "2*3^3*7" or a plain number, false when it doesn't parse or overflows
+bool parse_product(const std::string& s, uint64_t& out){
+    uint128_t v = 1;
+    size_t i = 0;
+    while (i <= s.size()) {
+        size_t end = s.find('*', i);
+        if (end == std::string::npos) end = s.size();
+        std::string factor = s.substr(i, end - i);
+        size_t caret = factor.find('^');
+        uint128_t base = 0, exp = 1;
+        if (!parse_u128(factor.substr(0, caret), base)) return false;
+        if (caret != std::string::npos && !parse_u128(factor.substr(caret + 1), exp)) return false;
+        if (exp > 128) return false;
+        for (uint128_t e = 0; e < exp; ++e) {
+            v *= base;
+            if (v > UINT64_MAX) return false;
+        }
+        i = end + 1;
+    }
+    out = static_cast<uint64_t>(v);
+    return true;
+}
+
+// the kernels on a full or final group of products
+void check(std::vector<uint128_t>& group){
+    if (group.empty()) return;
+    uint64_t fermat = fermat2_batch(group.data(), group.size());
+    uint64_t fib = fib_batch(group.data(), group.size());
+    for (size_t i = 0; i < group.size(); ++i) {
+        uint128_t n = group[i];
+        if (!(fermat >> i & 1) || (fib_side && !(fib >> i & 1))) {
+            kernel_failures++;
+            continue;
+        }
+        if (!(fib >> i & 1)) {
+            std::lock_guard<std::mutex> guard(print_lock);
+            std::cout << to_string(n) << " is a base-2 pseudoprime, " << static_cast<unsigned>(n % 5) << " mod 5" << std::endl;
+            pseudoprimes++;
+            continue;
+        }
+        if ((n % 5 != 2 && n % 5 != 3) || verify(n).prime) continue;
+        std::lock_guard<std::mutex> guard(print_lock);
+        std::cout << to_string(n) << " passes both tests and is composite, counterexample found!" << std::endl;
+        found++;
+    }
+    products += group.size();
+    group.clear();
+}
+
+void worker(const construct::Search& search){
+    std::vector<uint128_t> group;
+    for (uint64_t t; (t = next_task++) < search.tasks(); tasks_done++) {
+        walked += search.run(t, [&](uint128_t n) {
+            group.push_back(n);
+            if (group.size() == 64) check(group);
+        });
+    }
+    check(group);
+}
+
+int main(int argc, char* argv[]){
+    // a family of 12 primes, LK/2 about 2^94, far fewer primes than a
+    // match needs (see construct.h), the warning below says as much
+    uint64_t L = 2ULL * 9 * 49 * 17 * 23 * 29 * 31 * 71 * 101 * 113 * 127;
+    uint64_t K = 128ULL * 121 * 169 * 37 * 67 * 131;
+    unsigned bits = 128, table_bits = 22, task_bits = 12;
+    unsigned threads = std::thread::hardware_concurrency();
+    bool list = false, ok = true;
+    for (int a = 1; a < argc && ok; ++a) {
+        std::string arg = argv[a];
+        if (arg == "--L" && a + 1 < argc) ok = parse_product(argv[++a], L);
+        else if (arg == "--K" && a + 1 < argc) ok = parse_product(argv[++a], K);
+        else if (arg == "--bits" && a + 1 < argc) {
+            bits = std::stoul(argv[++a]);
+            ok = bits >= 2 && bits <= 128;
+        }
+        else if (arg == "--table-bits" && a + 1 < argc) table_bits = std::min(32ul, std::stoul(argv[++a]));
+        else if (arg == "--threads" && a + 1 < argc) threads = std::stoul(argv[++a]);
+        else if (arg == "--list") list = true;
+        else if (arg == "--fermat-only") fib_side = false;
+        else ok = false;
+    }
+    if (!ok) {
+        std::cout << "usage: " << argv[0] << " [--L PRODUCT] [--K PRODUCT] [--bits B] [--table-bits N] [--threads N] [--list] [--fermat-only]" << std::endl;
+        return 1;
+    }
+    if (threads == 0) threads = 1;
+    if (!fib_side) K = 2;
+
+    auto t0 = std::chrono::steady_clock::now();
+    construct::Family family;
+    std::string error;
+    if (!family.build(L, K, error)) {
+        std::cout << "Bad family L = " << L << ", K = " << K << ": " << error << std::endl;
+        return 1;
+    }
+    std::cout << "Family L = " << L << ", K = " << K << ": " << family.primes.size() << " primes" << std::endl;
+    if (list) {
+        for (uint64_t p : family.primes) std::cout << "  " << p << std::endl;
+    }
+    if (family.subset_bits() + 10 < family.residue_bits()) {
+        std::cout << "Warning: about 2^" << static_cast<int>(family.subset_bits()) << " odd subsets against "
+                  << "residues mod LK/2, about 2^" << static_cast<int>(family.residue_bits())
+                  << ": no product can be expected to match, a family needs about as many primes as bits in LK/2" << std::endl;
+    }
+
+    uint128_t bound = bits == 128 ? 0 : static_cast<uint128_t>(1) << bits;
+    construct::Search search(family, bound, table_bits, task_bits);
+    std::cout << "Products below 2^" << bits << ": " << search.table_size() << " subsets of the smallest "
+              << search.table_primes() << " primes in the table, " << search.tasks() << " tasks on "
+              << threads << " threads" << std::endl;
+
+    std::vector<std::thread> pool;
+    for (unsigned i = 0; i < threads; ++i) pool.emplace_back(worker, std::cref(search));
+    while (tasks_done < search.tasks()) {
+        for (int i = 0; i < 100 && tasks_done < search.tasks(); ++i) usleep(100000);
+        std::cout << tasks_done << " / " << search.tasks() << " tasks, " << walked << " subsets walked, "
+                  << products << " products" << std::endl;
+    }
+    for (auto& t : pool) t.join();
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "Walked " << walked << " subsets, " << products << " products tested, ";
+    if (!fib_side) std::cout << pseudoprimes << " pseudoprime(s), ";
+    std::cout << found << " counterexample(s) (" << secs << " s)" << std::endl;
+    if (kernel_failures) {
+        std::cout << kernel_failures << " product(s) failed the kernels, the construction is broken" << std::endl;
+        return 1;
+    }
+    return found ? 2 : 0;
+}
+
+// LINUX COMPILE:
+// g++ construct.cpp -o construct -O3 -march=native -pthread
+
+// the Fermat side alone, 82 pseudoprimes below 2^64 from the 35 primes of
+// ord_p(2) | 144144 (3706 below 2^96):
+// ./construct --fermat-only --L 2^4*3^2*7*11*13 --bits 64 --list
+
+// the full search on the default family, a smaller bound to see how far the
+// table reaches; it warns that 12 primes cannot be expected to hit LK/2:
+// ./construct --bits 96 --table-bits 20
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "modarith.h"
+#include "primality.h"
+#include "sieve.h"
+#include "factor.h"
+
+// structured candidates: squarefree products of primes chosen so that the
+// product passes both tests by construction, after Pomerance's heuristic
+// and the Chen/Greene search; a counterexample is expected among numbers
+// with many prime factors, where a scan of the odd numbers never gets
+//
+// fix an even L and a K with gcd(L, K) = 2 and 5 dividing neither, and
+// take the primes p == ±2 mod 5, prime to L and K, with
+//   ord_p(2) | L   (2^L == 1 mod p)
+//   z(p) | K       (p | F(K), z the rank of apparition)
+// candidates are p - 1 | L, p + 1 | K and the prime factors of 2^d - 1,
+// d | L, and of F(e), e | K, as far as those fit in 64 bits (the primes of
+// small order or rank, 127, 73, 2^31 - 1, 89, ...); the two conditions are
+// then checked exactly; for a product n of k distinct such primes
+//   n == 1 mod L    gives 2^(n-1) == 1 mod p for every p, so mod n
+//   n == -1 mod K   gives z(p) | n + 1, so F(n+1) == 0 mod n
+//   k odd           gives (n/5) = -1, i.e. n == ±2 mod 5
+// so every subset of odd size >= 3 whose product is 1 mod L and -1 mod K
+// is a counterexample; none is known, and a family only has a fair chance
+// at one when it has about log2(LK/2) primes or more (2^k subsets against
+// LK/2 residues), which the 64-bit L and K here rarely give
+//
+// K = 2 leaves out the Fibonacci side (n == -1 mod 2 only says n is odd):
+// the products are then base-2 pseudoprimes == ±2 mod 5 built from the
+// primes of ord_p(2) | L, which do turn up and exercise the search and the
+// kernels, and each one fails the Fibonacci test unless it is the real thing
+//
+// subsets are matched by meet in the middle: the products mod L and mod K
+// of the subsets of the smallest primes go in a sorted table (at most
+// 2^table_bits of them), and each subset of the rest, with its inverses
+// kept along the walk, looks up the residues it needs; the walk over the rest is cut
+// into tasks by the choice of its first primes, and every walk stops where
+// the product reaches the bound, 2^128 at most
+
+namespace construct {
+
+// a^-1 mod m for gcd(a, m) = 1
+inline uint64_t inverse(uint64_t a, uint64_t m){
+    __int128 old_r = a % m, r = m, old_s = 1, s = 0;
+    while (r != 0) {
+        __int128 k = old_r / r;
+        __int128 t = old_r - k * r; old_r = r; r = t;
+        t = old_s - k * s; old_s = s; s = t;
+    }
+    return static_cast<uint64_t>((old_s % m + m) % m);
+}
+
+inline uint64_t mul_mod(uint64_t a, uint64_t b, uint64_t m){
+    return static_cast<uint64_t>(static_cast<uint128_t>(a) * b % m);
+}
+
+inline std::vector<uint64_t> divisors(uint64_t x){
+    std::vector<uint64_t> d = {1};
+    for (uint64_t f : sieve_detail::prime_factors(x)) {
+        size_t n = d.size();
+        for (uint64_t pk = f; x % pk == 0; pk *= f) {
+            for (size_t i = 0; i < n; ++i) d.push_back(d[i] * pk);
+            if (pk > x / f) break;
+        }
+    }
+    return d;
+}
+
+// the prime factors of x appended to out, exponents dropped
+inline void prime_factors(uint64_t x, std::vector<uint64_t>& out){
+    for (const factor::Factor& f : factor::factor_only(x)) out.push_back(static_cast<uint64_t>(f.p));
+}
+
+struct Family {
+    uint64_t L = 0, K = 0;
+    std::vector<uint64_t> primes;   // ascending
+
+    // false with a message when L and K don't fit the construction
+    bool build(uint64_t l, uint64_t k, std::string& error) {
+        L = l;
+        K = k;
+        if (L < 2 || K < 2 || L % 2 || K % 2 || sieve_detail::gcd(L, K) != 2) {
+            error = "L and K must be even with gcd(L, K) = 2";
+            return false;
+        }
+        if (L % 5 == 0 || K % 5 == 0) {
+            error = "5 must divide neither L nor K";
+            return false;
+        }
+        std::vector<uint64_t> cand;
+        for (uint64_t d : divisors(L)) {
+            cand.push_back(d + 1);
+            if (d < 64) prime_factors((1ULL << d) - 1, cand);
+        }
+        // F(93) is the last Fibonacci number below 2^64
+        uint64_t fib[94] = {0, 1};
+        for (int i = 2; i < 94; ++i) fib[i] = fib[i - 1] + fib[i - 2];
+        for (uint64_t e : divisors(K)) {
+            cand.push_back(e - 1);
+            if (e > 2 && e < 94) prime_factors(fib[e], cand);
+        }
+        std::sort(cand.begin(), cand.end());
+        cand.erase(std::unique(cand.begin(), cand.end()), cand.end());
+
+        primes.clear();
+        for (uint64_t p : cand) {
+            if (p < 3 || (p % 5 != 2 && p % 5 != 3) || L % p == 0 || K % p == 0) continue;
+            if (!verify(p).prime) continue;
+            Montgomery m(p);
+            if (bin_exp(m, 2, L) != 1 || (K > 2 && lucas_fib(m, K) != 0)) continue;
+            primes.push_back(p);
+        }
+        return true;
+    }
+
+    // log2 of the odd-sized subsets against log2 of the residues mod LK/2
+    // they have to hit, the second well above the first means no match
+    // can be expected (the bound only cuts the subsets down further)
+    double subset_bits() const { return primes.empty() ? 0.0 : primes.size() - 1.0; }
+    double residue_bits() const { return std::log2(static_cast<double>(L)) + std::log2(static_cast<double>(K)) - 1; }
+};
+
+class Search {
+private:
+    struct Residue {
+        uint64_t mod_l, mod_k;
+
+        bool operator<(const Residue& r) const { return mod_l != r.mod_l ? mod_l < r.mod_l : mod_k < r.mod_k; }
+        bool operator==(const Residue& r) const { return mod_l == r.mod_l && mod_k == r.mod_k; }
+    };
+
+    struct Entry {
+        Residue r;      // the product mod L and mod K
+        uint32_t mask;  // the subset, bit i for primes[i]
+
+        bool operator<(const Entry& e) const { return r < e.r; }
+    };
+
+    const Family& f;
+    uint128_t bound;                // products stay below it
+    size_t a;                       // primes [0, a) are the table side
+    size_t t;                       // the first t primes of the rest pick the task
+    std::vector<uint64_t> inv_l;    // primes[i]^-1 mod L
+    std::vector<uint64_t> inv_k;    // and mod K
+    std::vector<Entry> table;
+
+public:
+    // bound 0 stands for 2^128
+    Search(const Family& family, uint128_t limit, unsigned table_bits, unsigned task_bits)
+        : f(family), bound(limit) {
+        size_t k = f.primes.size();
+        a = std::min<size_t>({table_bits, 32, (k + 1) / 2});
+        t = std::min<size_t>(task_bits, k - a);
+        for (uint64_t p : f.primes) {
+            inv_l.push_back(inverse(p, f.L));
+            inv_k.push_back(inverse(p, f.K));
+        }
+        fill(0, 1, {1, 1}, 0);
+        std::sort(table.begin(), table.end());
+    }
+
+    size_t table_size() const { return table.size(); }
+    size_t table_primes() const { return a; }
+    size_t tasks() const { return static_cast<size_t>(1) << t; }
+
+    // walks the subsets of the rest that start with task's choice of its
+    // first t primes, calling emit(n) for every product of a matching odd
+    // subset of size >= 3; returns the subsets walked
+    template <typename Emit>
+    uint64_t run(size_t task, Emit emit) const {
+        uint128_t prod = 1;
+        Residue r = {1, 1};     // prod^-1
+        unsigned count = 0;
+        for (size_t i = 0; i < t; ++i) {
+            if (!(task >> i & 1)) continue;
+            if (!fits(prod, f.primes[a + i])) return 0;
+            prod *= f.primes[a + i];
+            r = times(r, inv_l[a + i], inv_k[a + i]);
+            count++;
+        }
+        return walk(a + t, prod, r, count, emit);
+    }
+
+private:
+    bool fits(uint128_t prod, uint64_t p) const {
+        uint128_t room = (bound ? bound - 1 : ~static_cast<uint128_t>(0)) / p;
+        return prod <= room;
+    }
+
+    Residue times(const Residue& r, uint64_t by_l, uint64_t by_k) const {
+        return {mul_mod(r.mod_l, by_l, f.L), mul_mod(r.mod_k, by_k, f.K)};
+    }
+
+    void fill(size_t i, uint128_t prod, const Residue& r, uint32_t mask) {
+        if (i == a) {
+            table.push_back({r, mask});
+            return;
+        }
+        fill(i + 1, prod, r, mask);
+        uint64_t p = f.primes[i];
+        if (fits(prod, p)) fill(i + 1, prod * p, times(r, p, p), mask | 1u << i);
+    }
+
+    // r is prod^-1, count the primes in prod
+    template <typename Emit>
+    uint64_t walk(size_t i, uint128_t prod, const Residue& r, unsigned count, Emit& emit) const {
+        match(prod, r, count, emit);
+        uint64_t walked = 1;
+        for (size_t j = i; j < f.primes.size() && fits(prod, f.primes[j]); ++j) {
+            walked += walk(j + 1, prod * f.primes[j], times(r, inv_l[j], inv_k[j]), count + 1, emit);
+        }
+        return walked;
+    }
+
+    // table subsets whose product completes this one to 1 mod L, -1 mod K
+    template <typename Emit>
+    void match(uint128_t prod, const Residue& r, unsigned count, Emit& emit) const {
+        Entry need = {{r.mod_l, f.K - r.mod_k}, 0};
+        auto it = std::lower_bound(table.begin(), table.end(), need);
+        for (; it != table.end() && it->r == need.r; ++it) {
+            unsigned k = count + __builtin_popcount(it->mask);
+            if (k < 3 || !(k & 1)) continue;
+            uint128_t n = prod;
+            bool ok = true;
+            for (uint32_t m = it->mask; m && ok; m &= m - 1) {
+                uint64_t p = f.primes[__builtin_ctz(m)];
+                ok = fits(n, p);
+                n *= p;
+            }
+            if (ok) emit(n);
+        }
+    }
+};
+
+} // namespace construct
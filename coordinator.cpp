@@ -0,0 +1,305 @@
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+
+#include "modarith.h"
+#include "lease.h"
+
+// splits [start, end) into fixed-size work units and leases them to
+// main --worker processes over the protocol in lease.h
+// completed units and hits go to an append-only state file that is
+// fsynced per record, so a restarted coordinator picks up where it was;
+// units that were leased but not completed are simply handed out again
+
+typedef std::chrono::steady_clock Clock;
+
+std::atomic_bool stop_requested(false);
+
+void handle_stop(int){
+    stop_requested = true;
+}
+
+class Coordinator {
+private:
+    struct Lease {
+        int fd;
+        Clock::time_point deadline;
+    };
+    struct Conn {
+        std::string name, buf;
+    };
+
+    uint128_t start, end;
+    uint64_t unit_size, unit_count;
+    unsigned timeout;
+    FILE* journal = nullptr;
+
+    uint64_t next_unit = 0;        // lowest unit never leased
+    std::set<uint64_t> requeued;   // expired or dropped, handed out before new ones
+    std::map<uint64_t, Lease> leases;
+    uint64_t frontier = 0;         // units below this are all complete
+    std::set<uint64_t> completed;  // complete units at or past the frontier
+    uint64_t units_done = 0, tested = 0;
+    bool found = false;            // a counterexample was reported
+    std::map<int, Conn> conns;
+
+    bool is_complete(uint64_t id) const { return id < frontier || completed.count(id); }
+
+    void mark_complete(uint64_t id) {
+        if (is_complete(id)) return;
+        completed.insert(id);
+        units_done++;
+        while (completed.count(frontier)) completed.erase(frontier++);
+        requeued.erase(id);
+    }
+
+    bool record(const std::string& line) {
+        if (fprintf(journal, "%s\n", line.c_str()) < 0 || fflush(journal) != 0) return false;
+        return fsync(fileno(journal)) == 0;
+    }
+
+    uint128_t unit_lo(uint64_t id) const { return start + static_cast<uint128_t>(id) * unit_size; }
+    uint128_t unit_hi(uint64_t id) const { return id + 1 == unit_count ? end : unit_lo(id + 1); }
+
+    // next unit to lease, false when none is free right now
+    bool take_unit(uint64_t& id) {
+        if (!requeued.empty()) {
+            id = *requeued.begin();
+            requeued.erase(requeued.begin());
+            return true;
+        }
+        while (next_unit < unit_count && is_complete(next_unit)) next_unit++;
+        if (next_unit >= unit_count) return false;
+        id = next_unit++;
+        return true;
+    }
+
+    void release(uint64_t id) {
+        leases.erase(id);
+        if (!is_complete(id)) requeued.insert(id);
+    }
+
+    void drop(int fd) {
+        std::vector<uint64_t> held;
+        for (const auto& l : leases) {
+            if (l.second.fd == fd) held.push_back(l.first);
+        }
+        for (uint64_t id : held) release(id);
+        if (!held.empty()) std::cout << conns[fd].name << " disconnected, " << held.size() << " unit(s) back in the pool" << std::endl;
+        conns.erase(fd);
+        close(fd);
+    }
+
+    std::string handle(int fd, const std::vector<std::string>& w) {
+        Conn& c = conns[fd];
+        if (w[0] == "HELLO" && w.size() == 2) {
+            c.name = w[1];
+            std::cout << c.name << " connected" << std::endl;
+            return "OK";
+        }
+        if (w[0] == "LEASE") {
+            uint64_t id;
+            if (found || finished()) return "DONE";
+            if (!take_unit(id)) return "WAIT 5";
+            leases[id] = {fd, Clock::now() + std::chrono::seconds(timeout)};
+            return "UNIT " + std::to_string(id) + " " + to_string(unit_lo(id)) + " " + to_string(unit_hi(id));
+        }
+        if (w[0] == "HEARTBEAT" && w.size() == 3) {
+            uint64_t id = std::stoull(w[1]);
+            auto it = leases.find(id);
+            if (it == leases.end() || it->second.fd != fd) return "EXPIRED";
+            if (is_complete(id)) {
+                // an expired holder finished it after all
+                leases.erase(it);
+                return "EXPIRED";
+            }
+            it->second.deadline = Clock::now() + std::chrono::seconds(timeout);
+            return "OK";
+        }
+        if (w[0] == "COMPLETE" && w.size() == 3) {
+            uint64_t id = std::stoull(w[1]);
+            if (id >= unit_count) return "ERROR unknown unit";
+            // a late worker's result still counts, the unit was fully tested
+            if (!is_complete(id)) {
+                if (!record("complete " + w[1] + " " + w[2])) return "ERROR state file";
+                mark_complete(id);
+                tested += std::stoull(w[2]);
+            }
+            auto it = leases.find(id);
+            if (it != leases.end() && it->second.fd == fd) leases.erase(it);
+            return "OK";
+        }
+        if (w[0] == "HIT" && w.size() == 5) {
+            if (!record("hit " + w[1] + " " + w[2] + " " + w[3] + " " + w[4])) return "ERROR state file";
+            std::cout << c.name << " reports " << w[2] << " in unit " << w[1]
+                      << " passing both tests but composite (witness " << w[3] << ", factor " << w[4] << ")" << std::endl;
+            found = true;
+            return "OK";
+        }
+        return "ERROR bad request";
+    }
+
+    void expire() {
+        auto now = Clock::now();
+        std::vector<uint64_t> expired;
+        for (const auto& l : leases) {
+            if (l.second.deadline < now) expired.push_back(l.first);
+        }
+        for (uint64_t id : expired) {
+            std::cout << "Lease on unit " << id << " held by " << conns[leases[id].fd].name << " expired" << std::endl;
+            release(id);
+        }
+    }
+
+public:
+    Coordinator(uint128_t start, uint128_t end, uint64_t unit_size, unsigned timeout)
+        : start(start), end(end), unit_size(unit_size), timeout(timeout) {
+        uint128_t units = end > start ? (end - start - 1) / unit_size + 1 : 0;
+        unit_count = units > UINT64_MAX ? UINT64_MAX : static_cast<uint64_t>(units);
+        if (units > UINT64_MAX) this->end = start + static_cast<uint128_t>(unit_count) * unit_size;
+    }
+
+    ~Coordinator() { if (journal) fclose(journal); }
+
+    // replays an existing state file, then keeps it open for appending
+    bool open_state(const std::string& path) {
+        std::string header = "range " + to_string(start) + " " + to_string(end) + " " + std::to_string(unit_size);
+        std::ifstream in(path);
+        std::string line;
+        bool fresh = !std::getline(in, line);
+        if (!fresh && line != header) {
+            std::cout << "State file " << path << " is for a different range: " << line << std::endl;
+            return false;
+        }
+        while (std::getline(in, line)) {
+            std::vector<std::string> w = lease::split(line);
+            if (w.size() == 3 && w[0] == "complete") {
+                mark_complete(std::stoull(w[1]));
+                tested += std::stoull(w[2]);
+            } else if (w.size() == 5 && w[0] == "hit") {
+                std::cout << "Recorded hit: " << w[2] << " in unit " << w[1] << std::endl;
+                found = true;
+            }
+        }
+        journal = fopen(path.c_str(), "a");
+        if (!journal) return false;
+        return !fresh || record(header);
+    }
+
+    bool finished() const { return frontier >= unit_count; }
+
+    int run(int listener) {
+        auto last_status = Clock::now();
+        while (!stop_requested) {
+            std::vector<pollfd> fds = {{listener, POLLIN, 0}};
+            for (const auto& c : conns) fds.push_back({c.first, POLLIN, 0});
+            if (poll(fds.data(), fds.size(), 1000) < 0 && errno != EINTR) return 1;
+
+            if (fds[0].revents & POLLIN) {
+                int fd = accept(listener, nullptr, nullptr);
+                if (fd >= 0) conns[fd] = {"worker-" + std::to_string(fd), ""};
+            }
+            for (size_t i = 1; i < fds.size(); ++i) {
+                if (!fds[i].revents) continue;
+                int fd = fds[i].fd;
+                char chunk[4096];
+                ssize_t r = recv(fd, chunk, sizeof(chunk), 0);
+                if (r <= 0) {
+                    drop(fd);
+                    continue;
+                }
+                std::vector<std::string> lines;
+                conns[fd].buf.append(chunk, static_cast<size_t>(r));
+                lease::take_lines(conns[fd].buf, lines);
+                for (const std::string& line : lines) {
+                    std::vector<std::string> w = lease::split(line);
+                    if (w.empty()) continue;
+                    std::string reply;
+                    try {
+                        reply = handle(fd, w);
+                    } catch (const std::exception&) {
+                        reply = "ERROR bad number";
+                    }
+                    if (!lease::send_line(fd, reply)) break;
+                }
+            }
+            expire();
+
+            if (std::chrono::duration_cast<std::chrono::seconds>(Clock::now() - last_status).count() >= 10) {
+                std::cout << units_done << " units complete (all below unit " << frontier << "), "
+                          << leases.size() << " leased, " << conns.size() << " workers, "
+                          << tested << " candidates tested" << std::endl;
+                last_status = Clock::now();
+            }
+            if ((found || finished()) && conns.empty()) break;
+        }
+
+        if (found) std::cout << "Counterexample reported, see the state file." << std::endl;
+        else if (finished()) std::cout << "All " << unit_count << " units complete, " << tested << " candidates tested." << std::endl;
+        else std::cout << "Stopped with " << units_done << " of " << unit_count << " units complete." << std::endl;
+        return 0;
+    }
+};
+
+int main(int argc, char* argv[]){
+    std::string listen_addr = "127.0.0.1:7433";
+    std::string state_path = "psw.units";
+    uint128_t start = 4294967295ULL, end = 18446744073709551615ULL;
+    uint64_t unit_size = 1ULL << 32;
+    unsigned timeout = 300; // seconds without a heartbeat before a lease is dropped
+
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        bool ok = a + 1 < argc;
+        if (ok && arg == "--listen") listen_addr = argv[++a];
+        else if (ok && arg == "--state") state_path = argv[++a];
+        else if (ok && arg == "--start") ok = parse_u128(argv[++a], start);
+        else if (ok && arg == "--end") ok = parse_u128(argv[++a], end);
+        else if (ok && arg == "--unit-size") unit_size = std::stoull(argv[++a]);
+        else if (ok && arg == "--lease-timeout") timeout = std::stoul(argv[++a]);
+        else ok = false;
+        if (!ok || unit_size == 0) {
+            std::cout << "usage: " << argv[0] << " [--listen host:port|unix:/path] [--state FILE] [--start N] [--end N]"
+                      << " [--unit-size N] [--lease-timeout SECONDS]" << std::endl;
+            return 1;
+        }
+    }
+
+    Coordinator coordinator(start, end, unit_size, timeout);
+    if (!coordinator.open_state(state_path)) {
+        std::cout << "Could not use state file " << state_path << std::endl;
+        return 1;
+    }
+    int listener = lease::listen_on(listen_addr);
+    if (listener < 0) {
+        std::cout << "Could not listen on " << listen_addr << std::endl;
+        return 1;
+    }
+    signal(SIGINT, handle_stop);
+    signal(SIGTERM, handle_stop);
+    std::cout << "Leasing units of " << unit_size << " over [" << to_string(start) << ", " << to_string(end)
+              << ") on " << listen_addr << std::endl;
+
+    int status = coordinator.run(listener);
+    close(listener);
+    return status;
+}
+
+// LINUX COMPILE:
+// g++ coordinator.cpp -o coordinator -O3
+
+// on one host over loopback:
+// ./coordinator --listen 127.0.0.1:7433 --unit-size 1000000000 &
+// ./main 2 --worker 127.0.0.1:7433 &
+// ./main 2 --worker 127.0.0.1:7433
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "modarith.h"
+#include "primality.h"
+
+// factorization of the composites the search turns up (base-2
+// pseudoprimes, mostly), with the structure a PSW construction cares
+// about for each prime: ord_p(2) and the Fibonacci rank z(p), the least k
+// with p | F(k)
+//
+//   trial division   by the primes below 2^12 from a table
+//   Pollard-Brent    rho on Montgomery arithmetic, x^2 + c, gcds over
+//                    batches of 128 steps, a few values of c
+//   SQUFOF           when rho runs out of steps on a 64-bit cofactor
+//                    below 2^63 (Shanks, with the usual multipliers)
+//
+// 128-bit cofactors go through the same rho; one whose smallest prime is
+// too large for the step budget stays a composite factor in the result
+
+namespace factor {
+
+struct Factor {
+    uint128_t p;
+    unsigned exponent;
+    bool prime;         // false for a cofactor nothing could split
+    uint128_t order;    // ord_p(2), 0 for p = 2 and unsplit cofactors
+    uint128_t rank;     // z(p), 0 for unsplit cofactors
+};
+
+inline const std::vector<uint32_t>& small_primes(){
+    static const std::vector<uint32_t> table = [] {
+        std::vector<uint32_t> t;
+        std::vector<bool> composite(1 << 12, false);
+        for (uint32_t p = 2; p < (1 << 12); ++p) {
+            if (composite[p]) continue;
+            t.push_back(p);
+            for (uint32_t j = p * p; j < (1 << 12); j += p) composite[j] = true;
+        }
+        return t;
+    }();
+    return table;
+}
+
+template <typename T>
+inline T gcd(T a, T b){
+    while (b) {
+        T t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// a nontrivial factor of odd composite n, or 0 after max_steps per c
+template <typename T>
+inline T brent(T n, uint64_t max_steps){
+    typedef MontgomeryT<T> M;
+    const M m(n);
+    const uint64_t batch = 128;
+    for (uint64_t c = 1; c <= 8; ++c) {
+        T cm = m.to_mont(c);
+        auto step = [&](T v) { return m.add(m.sqr(v), cm); };
+        auto diff = [](T a, T b) { return a > b ? a - b : b - a; };
+        T y = m.to_mont(2), x = y, ys = y, q = m.one, g = 1;
+        uint64_t steps = 0;
+        for (uint64_t r = 1; g == 1 && steps < max_steps; r *= 2) {
+            x = y;
+            for (uint64_t i = 0; i < r; ++i) y = step(y);
+            for (uint64_t k = 0; k < r && g == 1; k += batch) {
+                ys = y;
+                for (uint64_t i = 0; i < std::min(batch, r - k); ++i) {
+                    y = step(y);
+                    q = m.mul(q, diff(x, y));
+                }
+                g = gcd(q, n);
+            }
+            steps += 2 * r;
+        }
+        if (g == n) {
+            // the batch went past the factor, walk it again one step at a time
+            do {
+                ys = step(ys);
+                g = gcd(diff(x, ys), n);
+            } while (g == 1);
+        }
+        if (g != 1 && g != n) return g;
+    }
+    return 0;
+}
+
+// a nontrivial factor of odd composite n < 2^63, or 0; kn stays below
+// 2^63, so P, Q and the products of the recurrences fit in an int64
+inline uint64_t squfof(uint64_t n){
+    static const uint64_t multipliers[] = {1, 3, 5, 7, 11, 15, 21, 33, 35, 55, 77, 105, 165, 231, 385, 1155};
+    uint64_t s = isqrt(n);
+    if (s * s == n) return s;
+    for (uint64_t k : multipliers) {
+        if (n >= (1ULL << 63) / k) break;
+        int64_t kn = static_cast<int64_t>(k * n);
+        int64_t p0 = static_cast<int64_t>(isqrt(kn));
+        int64_t q_prev = 1, q = kn - p0 * p0, p = p0;
+        if (q == 0) continue;
+        int64_t bound = 4 * static_cast<int64_t>(isqrt(2 * p0)) + 8;
+
+        // forward; at every square Q of an even step try the reverse cycle
+        // from its root, which ends where P repeats
+        for (int64_t i = 1; i < bound; ++i) {
+            int64_t b = (p0 + p) / q;
+            int64_t p_next = b * q - p;
+            int64_t q_next = q_prev + b * (p - p_next);
+            q_prev = q;
+            q = q_next;
+            p = p_next;
+            if (!(i & 1)) continue;
+            int64_t r = static_cast<int64_t>(isqrt(q));
+            if (r * r != q) continue;
+
+            int64_t rp = (p0 - p) / r * r + p;
+            int64_t rq_prev = r, rq = (kn - rp * rp) / r;
+            for (int64_t j = 0; j < bound && rq != 0; ++j) {
+                int64_t rb = (p0 + rp) / rq;
+                int64_t rp_next = rb * rq - rp;
+                if (rp_next == rp) break;
+                int64_t rq_next = rq_prev + rb * (rp - rp_next);
+                rq_prev = rq;
+                rq = rq_next;
+                rp = rp_next;
+            }
+            uint64_t f = gcd<uint64_t>(n, static_cast<uint64_t>(rp));
+            if (f != 1 && f != n) return f;
+        }
+    }
+    return 0;
+}
+
+inline bool is_prime(uint128_t n){
+    return verify(n).prime;
+}
+
+// the primes of n > 1 without trial division, appended with repeats;
+// unsplit cofactors go to rest
+inline void split(uint128_t n, std::vector<uint128_t>& primes, std::vector<uint128_t>& rest){
+    if (n == 1) return;
+    if (is_prime(n)) {
+        primes.push_back(n);
+        return;
+    }
+    uint128_t f = 0;
+    if (n >> 64 == 0) {
+        uint64_t n64 = static_cast<uint64_t>(n);
+        f = brent<uint64_t>(n64, 1 << 22);
+        if (f == 0 && n64 < (1ULL << 63)) f = squfof(n64);
+    }
+    else f = brent<uint128_t>(n, 1 << 24);
+    if (f == 0) {
+        rest.push_back(n);
+        return;
+    }
+    split(f, primes, rest);
+    split(n / f, primes, rest);
+}
+
+// the prime factors of n >= 1 in increasing order with their exponents,
+// no order or rank filled in
+inline std::vector<Factor> factor_only(uint128_t n){
+    std::vector<uint128_t> primes, rest;
+    for (uint32_t p : small_primes()) {
+        if (static_cast<uint128_t>(p) * p > n) break;
+        for (; n % p == 0; n /= p) primes.push_back(p);
+    }
+    if (n > 1) split(n, primes, rest);
+    std::sort(primes.begin(), primes.end());
+
+    std::vector<Factor> out;
+    for (uint128_t p : primes) {
+        if (!out.empty() && out.back().p == p) out.back().exponent++;
+        else out.push_back({p, 1, true, 0, 0});
+    }
+    for (uint128_t c : rest) out.push_back({c, 1, false, 0, 0});
+    return out;
+}
+
+// least d | m with f(d), given f(m) holds and f closed under multiples
+template <typename F>
+inline uint128_t least_divisor(uint128_t m, F f){
+    uint128_t d = m;
+    for (const Factor& q : factor_only(m)) {
+        if (!q.prime) continue;     // no way to take it out, d stays a multiple
+        while (d % q.p == 0 && f(d / q.p)) d /= q.p;
+    }
+    return d;
+}
+
+// ord_p(2) for an odd prime p
+inline uint128_t order2(uint128_t p){
+    if (p >> 64 == 0) {
+        Montgomery m(static_cast<uint64_t>(p));
+        return least_divisor(p - 1, [&](uint128_t e) { return pow2_mont(m, static_cast<uint64_t>(e)) == m.one; });
+    }
+    Montgomery128 m(p);
+    return least_divisor(p - 1, [&](uint128_t e) { return pow2_mont(m, e) == m.one; });
+}
+
+// z(p), which divides p - (5/p) for p != 2, 5
+inline uint128_t fib_rank(uint128_t p){
+    if (p == 2) return 3;
+    if (p == 5) return 5;
+    uint128_t m = p % 5 == 2 || p % 5 == 3 ? p + 1 : p - 1;
+    if (p >> 64 == 0) {
+        Montgomery mont(static_cast<uint64_t>(p));
+        return least_divisor(m, [&](uint128_t k) { return lucas_fib(mont, static_cast<uint64_t>(k)) == 0; });
+    }
+    Montgomery128 mont(p);
+    return least_divisor(m, [&](uint128_t k) { return lucas_fib(mont, k) == 0; });
+}
+
+// the full factorization with ord_p(2) and z(p) for every prime factor
+inline std::vector<Factor> factorize(uint128_t n){
+    std::vector<Factor> f = factor_only(n);
+    for (Factor& x : f) {
+        if (!x.prime) continue;
+        x.order = x.p == 2 ? 0 : order2(x.p);
+        x.rank = fib_rank(x.p);
+    }
+    return f;
+}
+
+// "561 = 3 [2, 4] * 11 [10, 10] * 17 [8, 9]", order and rank in brackets
+inline std::string describe(uint128_t n, const std::vector<Factor>& f){
+    std::string s = to_string(n) + " =";
+    for (size_t i = 0; i < f.size(); ++i) {
+        s += (i ? " * " : " ") + to_string(f[i].p);
+        if (f[i].exponent > 1) s += "^" + std::to_string(f[i].exponent);
+        if (f[i].prime) s += " [" + to_string(f[i].order) + ", " + to_string(f[i].rank) + "]";
+        else s += " [composite]";
+    }
+    return s;
+}
+
+} // namespace factor
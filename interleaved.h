@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "modarith.h"
+
+// interleaved scalar kernels: each ladder step waits on the multiply
+// before it, so a single candidate leaves the core's multipliers idle
+// for most of their latency; these run W independent candidates through
+// one loop (W = 2, 4 or 8), their multiply chains overlapping in the
+// pipeline, with no SIMD and for two-limb candidates as well
+//
+// the lanes step in lockstep over the longest exponent; a shorter one
+// stays at its starting value through the extra leading steps (1 squares
+// to 1 for Fermat, k = 0 doubles to k = 0 for Lucas), and the per-bit
+// choices are masks, not branches, so one lane's bits never cost the
+// others a mispredict
+
+namespace interleaved {
+
+template <typename M, typename T, size_t... I>
+inline std::array<M, sizeof...(I)> moduli(const T* cand, std::index_sequence<I...>){
+    return {{M(cand[I])...}};
+}
+
+// bit ? a : b without a branch
+template <typename T>
+inline T pick(T bit, T a, T b){
+    T mask = 0 - bit;
+    return (a & mask) | (b & ~mask);
+}
+
+// a + b mod n for a, b < n; Montgomery's add() and dbl() branch on the
+// wrap, which is fine for one candidate and a coin flip per lane here
+template <typename T>
+inline T add_mod(T a, T b, T n){
+    T s = a + b;
+    T wrap = static_cast<T>(s < a) | static_cast<T>(s >= n);
+    return s - (n & (0 - wrap));
+}
+
+// bit j of the result set when 2^(n-1) == 1 mod n for n = cand[j], odd n > 1
+template <int W, typename T>
+inline unsigned fermat2_lanes(const T* cand){
+    typedef MontgomeryT<T> M;
+    const std::array<M, W> m = moduli<M>(cand, std::make_index_sequence<W>());
+    T x[W];
+    int top = 0;
+    for (int j = 0; j < W; ++j) {
+        x[j] = m[j].one;
+        top = std::max(top, top_bit(cand[j] - 1));
+    }
+    for (int i = top; i >= 0; --i) {
+        for (int j = 0; j < W; ++j) {
+            T s = m[j].sqr(x[j]);
+            x[j] = pick<T>(((cand[j] - 1) >> i) & 1, add_mod(s, s, m[j].n), s);
+        }
+    }
+    unsigned mask = 0;
+    for (int j = 0; j < W; ++j) mask |= static_cast<unsigned>(x[j] == m[j].one) << j;
+    return mask;
+}
+
+// bit j set when F(n+1) == 0 mod n for n = cand[j], odd n > 1; the same
+// Lucas V ladder as lucas_fib(), started from k = 0 (V(0) = 2, V(1) = 1)
+// so the lanes can share a bit count; multiples of 5 go to lucas_fib()
+template <int W, typename T>
+inline unsigned fib_lanes(const T* cand){
+    typedef MontgomeryT<T> M;
+    const std::array<M, W> m = moduli<M>(cand, std::make_index_sequence<W>());
+    T d[W], v0[W], v1[W], odd[W], two[W];
+    int s[W];
+    int top = 0;
+    for (int j = 0; j < W; ++j) {
+        T k = cand[j] + 1;
+        s[j] = k ? trailing_zeros(k) : 0;
+        d[j] = k >> s[j];
+        two[j] = m[j].dbl(m[j].one);
+        v0[j] = two[j];
+        v1[j] = m[j].one;
+        odd[j] = 0;
+        if (d[j]) top = std::max(top, top_bit(d[j]));
+    }
+    for (int i = top; i >= 0; --i) {
+        for (int j = 0; j < W; ++j) {
+            const M& mj = m[j];
+            T bit = (d[j] >> i) & 1;
+            // V(2k) or V(2k+2) = square -+ 2, V(2k+1) = V(k)V(k+1) -+ 1
+            T sq = mj.sqr(pick(bit, v1[j], v0[j]));
+            T cross = mj.mul(v0[j], v1[j]);
+            sq = add_mod(sq, pick(odd[j] ^ bit, two[j], mj.n - two[j]), mj.n);
+            cross = add_mod(cross, pick(odd[j], mj.one, mj.n - mj.one), mj.n);
+            v0[j] = pick(bit, cross, sq);
+            v1[j] = pick(bit, sq, cross);
+            odd[j] = bit;
+        }
+    }
+    unsigned mask = 0;
+    for (int j = 0; j < W; ++j) {
+        const M& mj = m[j];
+        T acc;
+        if (mj.n % 5 == 0) acc = lucas_fib(mj, cand[j] + 1);
+        else {
+            // 5F(d), then V(d * 2^i) for each factor of two in n + 1
+            acc = mj.sub(mj.dbl(v1[j]), v0[j]);
+            T v = v0[j];
+            for (int i = 0; i < s[j] && acc != 0; ++i) {
+                acc = mj.mul(acc, v);
+                if (i + 1 < s[j]) v = (i == 0) ? mj.add(mj.sqr(v), two[j]) : mj.sub(mj.sqr(v), two[j]);
+            }
+        }
+        mask |= static_cast<unsigned>(acc == 0) << j;
+    }
+    return mask;
+}
+
+// up to 64 candidates, W at a time and the rest one by one
+template <int W, typename T>
+inline uint64_t fermat2_batch(const T* cand, size_t count){
+    uint64_t mask = 0;
+    size_t i = 0;
+    for (; i + W <= count; i += W) mask |= static_cast<uint64_t>(fermat2_lanes<W>(cand + i)) << i;
+    for (; i < count; ++i) mask |= static_cast<uint64_t>(fermat2_lanes<1>(cand + i)) << i;
+    return mask;
+}
+
+template <int W, typename T>
+inline uint64_t fib_batch(const T* cand, size_t count){
+    uint64_t mask = 0;
+    size_t i = 0;
+    for (; i + W <= count; i += W) mask |= static_cast<uint64_t>(fib_lanes<W>(cand + i)) << i;
+    for (; i < count; ++i) mask |= static_cast<uint64_t>(fib_lanes<1>(cand + i)) << i;
+    return mask;
+}
+
+} // namespace interleaved
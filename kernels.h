@@ -0,0 +1,294 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "modarith.h"
+#include "primality.h"
+#include "simd_fermat.h"
+#include "interleaved.h"
+
+// runtime kernel selection: the Fermat, Fibonacci and verify kernels over
+// 64-bit candidates exist in several variants, each compiled with its own
+// target attribute (flatten pulls the shared Montgomery code into it, so
+// the scalar ones get mulx and friends too), and cpuid rules out the ones
+// the CPU can't run at startup; a portable build (no -march) still runs
+// the AVX-512 kernels on a machine that has them
+//
+//   generic  whatever the build flags allow
+//   bmi2     scalar with BMI2/ADX
+//   ilp2/4/8 as bmi2, 2, 4 or 8 candidates interleaved (interleaved.h)
+//   avx2     4-lane Fermat ladder, the rest as bmi2
+//   avx512   8-lane Fermat ladder
+//   ifma     8-lane ladder on 52-bit madds for groups below 2^52
+//
+// every kernel takes count <= 64 candidates, odd and above 1, and returns
+// a mask, bit i for cand[i]: Fermat 2^(n-1) == 1 mod n, fib
+// F(n+1) == 0 mod n, verify n prime
+// calibrate() can time the variants on sample candidates instead, and
+// select() overrides either choice
+
+namespace kernels {
+
+enum Isa { generic, bmi2, ilp2, ilp4, ilp8, avx2, avx512, ifma, isa_count };
+const char* const isa_names[isa_count] = {"generic", "bmi2", "ilp2", "ilp4", "ilp8", "avx2", "avx512", "ifma"};
+
+enum Kind { fermat_kernel, fib_kernel, verify_kernel, kind_count };
+const char* const kind_names[kind_count] = {"fermat", "fib", "verify"};
+
+typedef uint64_t (*Kernel)(const uint64_t* cand, size_t count);
+
+inline uint64_t fib_body(const uint64_t* cand, size_t count){
+    uint64_t mask = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (lucas_fib(Montgomery(cand[i]), cand[i] + 1) == 0) mask |= 1ULL << i;
+    }
+    return mask;
+}
+
+inline uint64_t verify_body(const uint64_t* cand, size_t count){
+    uint64_t mask = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (verify(cand[i]).prime) mask |= 1ULL << i;
+    }
+    return mask;
+}
+
+#define PSW_FLAT __attribute__((flatten))
+#define PSW_TARGET_BMI2 __attribute__((target("bmi2,adx")))
+
+PSW_FLAT inline uint64_t fermat_generic(const uint64_t* c, size_t k){ return fermat2_scalar(c, k); }
+PSW_FLAT inline uint64_t fib_generic(const uint64_t* c, size_t k){ return fib_body(c, k); }
+PSW_FLAT inline uint64_t verify_generic(const uint64_t* c, size_t k){ return verify_body(c, k); }
+
+PSW_TARGET_BMI2 PSW_FLAT inline uint64_t fermat_bmi2(const uint64_t* c, size_t k){ return fermat2_scalar(c, k); }
+PSW_TARGET_BMI2 PSW_FLAT inline uint64_t fib_bmi2(const uint64_t* c, size_t k){ return fib_body(c, k); }
+PSW_TARGET_BMI2 PSW_FLAT inline uint64_t verify_bmi2(const uint64_t* c, size_t k){ return verify_body(c, k); }
+
+template <int W>
+PSW_TARGET_BMI2 PSW_FLAT inline uint64_t fermat_ilp(const uint64_t* c, size_t k){ return interleaved::fermat2_batch<W>(c, k); }
+template <int W>
+PSW_TARGET_BMI2 PSW_FLAT inline uint64_t fib_ilp(const uint64_t* c, size_t k){ return interleaved::fib_batch<W>(c, k); }
+
+PSW_TARGET_AVX2 PSW_FLAT inline uint64_t fermat_avx2(const uint64_t* c, size_t k){
+    uint64_t mask = 0;
+    size_t i = 0;
+    for (; i + 4 <= k; i += 4) mask |= static_cast<uint64_t>(fermat2_batch4(c + i)) << i;
+    if (i < k) mask |= fermat2_scalar(c + i, k - i) << i;
+    return mask;
+}
+PSW_TARGET_AVX2 PSW_FLAT inline uint64_t fib_avx2(const uint64_t* c, size_t k){ return fib_body(c, k); }
+PSW_TARGET_AVX2 PSW_FLAT inline uint64_t verify_avx2(const uint64_t* c, size_t k){ return verify_body(c, k); }
+
+PSW_TARGET_AVX512 PSW_FLAT inline uint64_t fermat_avx512(const uint64_t* c, size_t k){
+    uint64_t mask = 0;
+    size_t i = 0;
+    for (; i + 8 <= k; i += 8) mask |= static_cast<uint64_t>(fermat2_batch8(c + i)) << i;
+    for (; i + 4 <= k; i += 4) mask |= static_cast<uint64_t>(fermat2_batch4(c + i)) << i;
+    if (i < k) mask |= fermat2_scalar(c + i, k - i) << i;
+    return mask;
+}
+PSW_TARGET_AVX512 PSW_FLAT inline uint64_t fib_avx512(const uint64_t* c, size_t k){ return fib_body(c, k); }
+PSW_TARGET_AVX512 PSW_FLAT inline uint64_t verify_avx512(const uint64_t* c, size_t k){ return verify_body(c, k); }
+
+PSW_TARGET_IFMA PSW_FLAT inline uint64_t fermat_ifma(const uint64_t* c, size_t k){
+    uint64_t mask = 0;
+    size_t i = 0;
+    for (; i + 8 <= k; i += 8) {
+        uint64_t top = 0;
+        for (int j = 0; j < 8; ++j) top |= c[i + j];
+        unsigned m = top >> 52 ? fermat2_batch8(c + i) : fermat2_batch8_52(c + i);
+        mask |= static_cast<uint64_t>(m) << i;
+    }
+    for (; i + 4 <= k; i += 4) mask |= static_cast<uint64_t>(fermat2_batch4(c + i)) << i;
+    if (i < k) mask |= fermat2_scalar(c + i, k - i) << i;
+    return mask;
+}
+PSW_TARGET_IFMA PSW_FLAT inline uint64_t fib_ifma(const uint64_t* c, size_t k){ return fib_body(c, k); }
+PSW_TARGET_IFMA PSW_FLAT inline uint64_t verify_ifma(const uint64_t* c, size_t k){ return verify_body(c, k); }
+
+const Kernel variants[isa_count][kind_count] = {
+    {fermat_generic, fib_generic, verify_generic},
+    {fermat_bmi2, fib_bmi2, verify_bmi2},
+    {fermat_ilp<2>, fib_ilp<2>, verify_bmi2},
+    {fermat_ilp<4>, fib_ilp<4>, verify_bmi2},
+    {fermat_ilp<8>, fib_ilp<8>, verify_bmi2},
+    {fermat_avx2, fib_avx2, verify_avx2},
+    {fermat_avx512, fib_avx512, verify_avx512},
+    {fermat_ifma, fib_ifma, verify_ifma},
+};
+
+inline bool supported(Isa isa){
+    __builtin_cpu_init();
+    bool has_bmi2 = __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("adx");
+    bool has_avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq");
+    switch (isa) {
+    case generic: return true;
+    case bmi2: case ilp2: case ilp4: case ilp8: return has_bmi2;
+    case avx2: return has_bmi2 && __builtin_cpu_supports("avx2");
+    case avx512: return has_bmi2 && __builtin_cpu_supports("avx2") && has_avx512;
+    case ifma: return supported(avx512) && __builtin_cpu_supports("avx512ifma");
+    default: return false;
+    }
+}
+
+// first supported variant of each kind by default, fastest first as
+// measured near 2^32 and 2^63: interleaving beats the AVX2 ladder's
+// 32-bit partial products, and the Lucas ladder, already two multiplies
+// a step, peaks at four lanes
+const Isa preferred[kind_count][isa_count] = {
+    {ifma, avx512, ilp4, bmi2, generic},
+    {ilp4, bmi2, generic},
+    {bmi2, generic},
+};
+
+// the variant in use for each kind, the preferred one until calibrate()
+// or select() says otherwise; both belong before the workers start
+struct Selection {
+    Isa isa[kind_count];
+    Kernel fn[kind_count];
+
+    Selection() {
+        for (int k = 0; k < kind_count; ++k) {
+            const Isa* p = preferred[k];
+            while (!supported(*p)) ++p;    // every list ends in generic
+            set(static_cast<Kind>(k), *p);
+        }
+    }
+
+    void set(Kind k, Isa i) {
+        isa[k] = i;
+        fn[k] = variants[i][k];
+    }
+};
+
+inline Selection& selected(){
+    static Selection s;
+    return s;
+}
+
+// "fermat ifma, fib bmi2, verify bmi2"
+inline std::string describe(){
+    std::string s;
+    for (int k = 0; k < kind_count; ++k) {
+        s += (k ? ", " : "") + std::string(kind_names[k]) + " " + isa_names[selected().isa[k]];
+    }
+    return s;
+}
+
+// "avx2" for every kind, or "fermat=ifma,verify=generic" for some;
+// false with a message for an unknown or unsupported name
+inline bool select(const std::string& spec, std::string& error){
+    std::stringstream in(spec);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        size_t eq = item.find('=');
+        std::string kind = eq == std::string::npos ? "" : item.substr(0, eq);
+        std::string name = eq == std::string::npos ? item : item.substr(eq + 1);
+        int k = 0, i = 0;
+        while (k < kind_count && kind != kind_names[k]) ++k;
+        while (i < isa_count && name != isa_names[i]) ++i;
+        if ((eq != std::string::npos && k == kind_count) || i == isa_count) {
+            error = "unknown kernel " + item;
+            return false;
+        }
+        if (!supported(static_cast<Isa>(i))) {
+            error = std::string(isa_names[i]) + " kernels need instructions this CPU does not have";
+            return false;
+        }
+        for (int j = 0; j < kind_count; ++j) {
+            if (eq == std::string::npos || j == k) selected().set(static_cast<Kind>(j), static_cast<Isa>(i));
+        }
+    }
+    return true;
+}
+
+// ns per candidate of one kernel over sample, best of three passes
+inline double time_kernel(Kernel fn, const std::vector<uint64_t>& sample){
+    double best = 0;
+    volatile uint64_t sink = 0;
+    for (int pass = 0; pass < 3; ++pass) {
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < sample.size(); i += 64) sink = sink + fn(sample.data() + i, std::min<size_t>(64, sample.size() - i));
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+        if (pass == 0 || ns < best) best = ns;
+    }
+    return sample.empty() ? 0 : best / sample.size();
+}
+
+// times every supported variant of each kind on sample (odd candidates
+// like the ones the search will see; verify runs on the Fermat passers
+// among them) and keeps the fastest; returns one line per kind
+inline std::string calibrate(const std::vector<uint64_t>& sample){
+    std::vector<uint64_t> passers;
+    for (size_t i = 0; i < sample.size(); i += 64) {
+        size_t k = std::min<size_t>(64, sample.size() - i);
+        uint64_t mask = fermat_generic(sample.data() + i, k);
+        for (size_t j = 0; j < k; ++j) {
+            if (mask >> j & 1) passers.push_back(sample[i + j]);
+        }
+    }
+    std::ostringstream out;
+    for (int k = 0; k < kind_count; ++k) {
+        const std::vector<uint64_t>& input = k == verify_kernel ? passers : sample;
+        if (input.empty()) continue;
+        out << "  " << kind_names[k] << ":";
+        Isa best = generic;
+        double best_ns = 0;
+        for (int i = 0; i < isa_count; ++i) {
+            if (!supported(static_cast<Isa>(i))) continue;
+            double ns = time_kernel(variants[i][k], input);
+            out << " " << isa_names[i] << " " << static_cast<uint64_t>(ns + 0.5) << " ns";
+            if (i == generic || ns < best_ns) {
+                best = static_cast<Isa>(i);
+                best_ns = ns;
+            }
+        }
+        selected().set(static_cast<Kind>(k), best);
+        out << "\n";
+    }
+    return out.str();
+}
+
+} // namespace kernels
+
+// the dispatched entry points, bit i of the result for cand[i], count <= 64
+// two-limb candidates have no vector path; their Fermat ladder runs two
+// lanes interleaved (wider spills, and the CIOS multiply is busy enough
+// that interleaving the Lucas ladder gains nothing)
+inline uint64_t fermat2_batch(const uint64_t* cand, size_t count){
+    return kernels::selected().fn[kernels::fermat_kernel](cand, count);
+}
+
+inline uint64_t fermat2_batch(const uint128_t* cand, size_t count){
+    return interleaved::fermat2_batch<2>(cand, count);
+}
+
+inline uint64_t fib_batch(const uint64_t* cand, size_t count){
+    return kernels::selected().fn[kernels::fib_kernel](cand, count);
+}
+
+inline uint64_t fib_batch(const uint128_t* cand, size_t count){
+    uint64_t mask = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (lucas_fib(Montgomery128(cand[i]), cand[i] + 1) == 0) mask |= 1ULL << i;
+    }
+    return mask;
+}
+
+inline uint64_t prime_batch(const uint64_t* cand, size_t count){
+    return kernels::selected().fn[kernels::verify_kernel](cand, count);
+}
+
+inline uint64_t prime_batch(const uint128_t* cand, size_t count){
+    uint64_t mask = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (verify(cand[i]).prime) mask |= 1ULL << i;
+    }
+    return mask;
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "modarith.h"
+
+// line protocol between the coordinator and main --worker processes
+//
+//   worker                            coordinator
+//   HELLO <name>                      OK
+//   LEASE                             UNIT <id> <lo> <hi> | WAIT <seconds> | DONE
+//   HEARTBEAT <id> <frontier>         OK | EXPIRED
+//   COMPLETE <id> <tested>            OK
+//   HIT <id> <n> <witness> <factor>   OK
+//
+// numbers are decimal and may be wider than 64 bits, a unit covers [lo, hi)
+// a lease that sees no heartbeat within the coordinator's timeout goes back
+// to the pool and the late worker is told EXPIRED on its next heartbeat
+// addresses are host:port for TCP or unix:/path for a Unix domain socket
+
+namespace lease {
+
+inline std::vector<std::string> split(const std::string& line){
+    std::vector<std::string> words;
+    size_t i = 0;
+    while (i < line.size()) {
+        size_t j = line.find(' ', i);
+        if (j == std::string::npos) j = line.size();
+        if (j > i) words.push_back(line.substr(i, j - i));
+        i = j + 1;
+    }
+    return words;
+}
+
+// fills a sockaddr for addr, false when it cannot be resolved
+inline bool resolve(const std::string& addr, sockaddr_storage& sa, socklen_t& len){
+    memset(&sa, 0, sizeof(sa));
+    if (addr.compare(0, 5, "unix:") == 0) {
+        sockaddr_un* un = reinterpret_cast<sockaddr_un*>(&sa);
+        std::string path = addr.substr(5);
+        if (path.empty() || path.size() >= sizeof(un->sun_path)) return false;
+        un->sun_family = AF_UNIX;
+        memcpy(un->sun_path, path.c_str(), path.size() + 1);
+        len = sizeof(sockaddr_un);
+        return true;
+    }
+
+    size_t colon = addr.rfind(':');
+    if (colon == std::string::npos) return false;
+    std::string host = addr.substr(0, colon), port = addr.substr(colon + 1);
+    addrinfo hints, *res = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &res) != 0) return false;
+    memcpy(&sa, res->ai_addr, res->ai_addrlen);
+    len = res->ai_addrlen;
+    freeaddrinfo(res);
+    return true;
+}
+
+inline int connect_to(const std::string& addr){
+    sockaddr_storage sa;
+    socklen_t len;
+    if (!resolve(addr, sa, len)) return -1;
+    int fd = socket(sa.ss_family, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&sa), len) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (sa.ss_family != AF_UNIX) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+// a stale Unix socket file from an earlier run is replaced
+inline int listen_on(const std::string& addr){
+    sockaddr_storage sa;
+    socklen_t len;
+    if (!resolve(addr, sa, len)) return -1;
+    int fd = socket(sa.ss_family, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (sa.ss_family == AF_UNIX) {
+        unlink(reinterpret_cast<sockaddr_un*>(&sa)->sun_path);
+    } else {
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    }
+    if (bind(fd, reinterpret_cast<sockaddr*>(&sa), len) != 0 || listen(fd, 64) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+inline bool send_line(int fd, const std::string& line){
+    std::string out = line + "\n";
+    const char* p = out.data();
+    size_t left = out.size();
+    while (left > 0) {
+        ssize_t w = send(fd, p, left, MSG_NOSIGNAL);
+        if (w <= 0) return false;
+        p += w;
+        left -= static_cast<size_t>(w);
+    }
+    return true;
+}
+
+// moves every complete line out of buf, '\r' tolerated for telnet/nc use
+inline void take_lines(std::string& buf, std::vector<std::string>& lines){
+    size_t start = 0, nl;
+    while ((nl = buf.find('\n', start)) != std::string::npos) {
+        size_t end = nl > start && buf[nl - 1] == '\r' ? nl - 1 : nl;
+        lines.push_back(buf.substr(start, end - start));
+        start = nl + 1;
+    }
+    buf.erase(0, start);
+}
+
+struct Unit {
+    uint64_t id;
+    uint128_t lo, hi;
+};
+
+// blocking worker side of the protocol, one request in flight at a time
+class Client {
+private:
+    int fd = -1;
+    std::string buf;
+    std::vector<std::string> pending;
+
+    bool request(const std::string& line, std::vector<std::string>& reply) {
+        if (fd < 0 || !send_line(fd, line)) return false;
+        while (pending.empty()) {
+            char chunk[4096];
+            ssize_t r = recv(fd, chunk, sizeof(chunk), 0);
+            if (r <= 0) return false;
+            buf.append(chunk, static_cast<size_t>(r));
+            take_lines(buf, pending);
+        }
+        reply = split(pending.front());
+        pending.erase(pending.begin());
+        return !reply.empty();
+    }
+
+    bool ok(const std::string& line) {
+        std::vector<std::string> reply;
+        return request(line, reply) && reply[0] == "OK";
+    }
+
+public:
+    enum Status { GOT_UNIT, WAIT, FINISHED, LOST };
+
+    Client() {}
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+    ~Client() { if (fd >= 0) close(fd); }
+
+    bool connect(const std::string& addr, const std::string& name) {
+        fd = connect_to(addr);
+        return fd >= 0 && ok("HELLO " + name);
+    }
+
+    // GOT_UNIT fills unit, WAIT fills seconds
+    Status lease(Unit& unit, unsigned& seconds) {
+        std::vector<std::string> r;
+        if (!request("LEASE", r)) return LOST;
+        if (r[0] == "DONE") return FINISHED;
+        if (r[0] == "WAIT" && r.size() == 2) {
+            seconds = std::stoul(r[1]);
+            return WAIT;
+        }
+        if (r[0] == "UNIT" && r.size() == 4 && parse_u128(r[2], unit.lo) && parse_u128(r[3], unit.hi)) {
+            unit.id = std::stoull(r[1]);
+            return GOT_UNIT;
+        }
+        return LOST;
+    }
+
+    // false when the lease expired and the unit went to someone else,
+    // lost is set when the coordinator is gone
+    bool heartbeat(uint64_t id, uint128_t frontier, bool& lost) {
+        std::vector<std::string> r;
+        lost = !request("HEARTBEAT " + std::to_string(id) + " " + to_string(frontier), r);
+        return !lost && r[0] == "OK";
+    }
+
+    bool complete(uint64_t id, uint64_t tested) {
+        return ok("COMPLETE " + std::to_string(id) + " " + std::to_string(tested));
+    }
+
+    bool hit(uint64_t id, uint128_t n, uint64_t witness, uint64_t factor) {
+        return ok("HIT " + std::to_string(id) + " " + to_string(n) + " " +
+                  std::to_string(witness) + " " + std::to_string(factor));
+    }
+};
+
+} // namespace lease
@@ -1,98 +1,402 @@
-#include <stdexcept>
 #include <cmath>
 #include <iostream>
-#include <gmp.h>
 #include <thread>
-#include <queue>
 #include <ncurses.h>
 #include <atomic>
 #include <unistd.h>
 #include <cstdint>
-#include <mutex>
-#include <condition_variable>
 #include <vector>
 #include <chrono>
 #include <string>
+#include <memory>
+#include <algorithm>
+#include <csignal>
+#include <mutex>
+#include <fstream>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "modarith.h"
+#include "primality.h"
+#include "kernels.h"
+#include "sieve.h"
+#include "primemap.h"
+#include "scheduler.h"
+#include "checkpoint.h"
+#include "psplist.h"
+#include "lease.h"
+#include "stats.h"
+#include "topology.h"
+#include "wheel.h"
+#include "catalogue.h"
+#include "pipeline.h"
+#include "stream.h"
+#include "verifier.h"
+#include "factor.h"
 
-std::atomic_uint64_t progress;
-std::atomic_uint64_t numbers_processed;
-std::atomic_uint64_t current_testing;
 std::atomic_bool printing;
 std::atomic_bool done;
 std::atomic_uint64_t thread_count;
+std::atomic_bool stop_requested;      // set by SIGINT/SIGTERM
+std::atomic_bool checkpointing;
+std::atomic_uint64_t checkpoint_frontier;  // frontier of the last flushed checkpoint
+std::atomic_uint64_t checkpoint_frontier_hi;
+std::atomic_bool list_error;
+std::atomic_bool abandon_run;         // drop the current range: lease lost (--worker) or time up (--scaling)
+
+// Search range, every candidate in [search_start, search_end) gets tested
+const uint64_t search_start = 4294967295ULL;
+const uint64_t search_end = 18446744073709551615ULL;
+
+// one scheduler per candidate width, only the one for the running search is set
+template <typename T> std::unique_ptr<BasicRangeScheduler<T>> scheduler;
+std::unique_ptr<CongruenceSieve> sieve;
+std::unique_ptr<PrimeMap> prime_map;   // with the sieve stage, drops the primes of covered ranges
+
+// per-thread counters, workers only ever write their own block
+std::unique_ptr<stats::Publisher> run_stats;
+bool headless = false;                 // no ncurses, status lines on stdout instead
+std::ostream* status = &std::cout;     // stderr when stdout carries --stream results
+std::string stats_json_path, stats_prom_path;
+unsigned stats_interval = 10;          // seconds between exports and status lines
+
+// --stages: the filters every candidate batch runs through, in order
+std::vector<pipeline::Stage> stage_chain;
+
+// --catalogue: Fermat survivors of every range with their outcomes
+std::unique_ptr<catalogue::Writer> survivor_log;
+
+// a worker's range while the pool still verifies some of its survivors;
+// whoever drops the last reference writes its catalogue block and marks it
+// complete, so no checkpoint covers a survivor that was never verified
+template <typename T>
+struct RangeTicket {
+    typename BasicRangeScheduler<T>::Range range;
+    std::vector<catalogue::Entry> survivors;  // flushed as one block
+    std::mutex lock;
+    std::vector<uint32_t> primes;             // tags the pool proved prime, under lock
+    std::vector<T> composites;                // Fermat survivors the Fibonacci stage rejected
+    std::atomic<uint32_t> refs{1};            // the worker's plus one per queued job
+    std::atomic_bool failed{false};
+};
+
+template <typename T>
+struct VerifyJob {
+    T n;
+    uint32_t tag;
+    RangeTicket<T>* ticket;
+};
+
+// --verify-threads: most pool threads, 0 verifies on the search threads
+unsigned verify_threads = 0;
+unsigned search_threads = 0;  // pool thread i counts into stats block search_threads + i
+template <typename T> std::unique_ptr<verifier::Pool<VerifyJob<T>>> verify_pool;
+
+// --factors: the base-2 pseudoprimes the Fibonacci stage rejects, factored
+// with ord_p(2) and z(p) on a pool of their own at the lowest priority, one
+// job per range; a range the full queue turns away is counted, not
+// factored on the search thread
+struct FactorJob {
+    std::vector<uint128_t>* numbers;
+};
+
+std::unique_ptr<verifier::Pool<FactorJob>> factor_pool;
+std::ofstream factor_log;
+std::mutex factor_lock;
+std::atomic_uint64_t factored(0), factor_skipped(0);
 
-// Thread-safe work queue
-class WorkQueue {
-private:
-    std::queue<uint64_t> queue;
-    std::mutex mutex;
-    std::condition_variable cv;
-    bool shutdown = false;
+// CPU for each worker id, empty unless --pin
+std::vector<topology::Cpu> placement;
 
-public:
-    void push(uint64_t value) {
-        std::lock_guard<std::mutex> lock(mutex);
-        queue.push(value);
-        cv.notify_one();
+// binds the calling worker to its CPU; done before the worker allocates
+// its scratch so first touch places those pages on the worker's own node
+void pin_worker(unsigned id) {
+    if (!placement.empty()) topology::pin_to(placement[id % placement.size()].cpu);
+}
+
+// NUMA node of each of the first count workers, one scheduler group per node
+std::vector<unsigned> worker_nodes(unsigned count) {
+    std::vector<unsigned> nodes;
+    for (unsigned i = 0; i < count && !placement.empty(); ++i) nodes.push_back(placement[i % placement.size()].node);
+    return nodes;
+}
+
+// display values wider than one atomic word, the two halves may tear
+// for a moment which only matters to the printer
+void store_wide(std::atomic_uint64_t& lo, std::atomic_uint64_t& hi, uint128_t v) {
+    hi = static_cast<uint64_t>(v >> 64);
+    lo = static_cast<uint64_t>(v);
+}
+
+uint128_t load_wide(const std::atomic_uint64_t& lo, const std::atomic_uint64_t& hi) {
+    return static_cast<uint128_t>(hi.load()) << 64 | lo.load();
+}
+
+bool searching() {
+    return scheduler<uint64_t> || scheduler<uint128_t>;
+}
+
+uint128_t search_frontier() {
+    if (scheduler<uint64_t>) return scheduler<uint64_t>->frontier();
+    if (scheduler<uint128_t>) return scheduler<uint128_t>->frontier();
+    return 0;
+}
+
+// the counterexample behind done, reported to the coordinator in --worker mode
+std::mutex failure_mutex;
+uint128_t failed_candidate = 0;
+Verdict failed_verdict = {false, 0, 0};
+
+void report_failure(uint128_t candidate, const Verdict& v) {
+    {
+        std::lock_guard<std::mutex> lock(failure_mutex);
+        failed_candidate = candidate;
+        failed_verdict = v;
     }
-    
-    bool pop(uint64_t& value) {
-        std::unique_lock<std::mutex> lock(mutex);
-        cv.wait(lock, [this] { return !queue.empty() || shutdown; });
-        if (shutdown && queue.empty()) return false;
-        value = queue.front();
-        queue.pop();
-        return true;
+    *status << to_string(candidate) << " failed verification, not a prime.";
+    if (v.factor) *status << " Divisible by " << v.factor << ".";
+    if (v.witness) *status << " Strong pseudoprime test fails to base " << v.witness << ".";
+    *status << std::endl;
+}
+
+template <typename T>
+void finish_range(RangeTicket<T>* t) {
+    if (survivor_log) {
+        for (uint32_t tag : t->primes) t->survivors[tag].flags |= catalogue::prime;
+        // the primes the sieve stage logged came ahead of their batch's survivors
+        std::sort(t->survivors.begin(), t->survivors.end(),
+                  [](const catalogue::Entry& a, const catalogue::Entry& b) { return a.n < b.n; });
+        // the block goes out before the range counts as complete, a
+        // failure still records the counterexample and what led to it
+        if (!survivor_log->append(t->survivors)) {
+            std::cout << "Could not append to the catalogue" << std::endl;
+            done = true;
+            t->failed = true;
+        }
     }
-    
-    void shutdown_queue() {
-        std::lock_guard<std::mutex> lock(mutex);
-        shutdown = true;
-        cv.notify_all();
+    if (!t->failed) scheduler<T>->complete(t->range);
+    if (factor_pool && !t->composites.empty()) {
+        FactorJob job = {new std::vector<uint128_t>(t->composites.begin(), t->composites.end())};
+        if (!factor_pool->try_push(job)) {
+            factor_skipped += job.numbers->size();
+            delete job.numbers;
+        }
     }
-    
-    size_t size() {
-        std::lock_guard<std::mutex> lock(mutex);
-        return queue.size();
+    delete t;
+}
+
+template <typename T>
+void release(RangeTicket<T>* t) {
+    if (t->refs.fetch_sub(1) == 1) finish_range(t);
+}
+
+template <typename T>
+void verify_job(unsigned id, VerifyJob<T>& job) {
+    stats::WorkerStats& st = run_stats->worker(search_threads + id);
+    uint64_t t0 = stats::now_ns();
+    Verdict v = verify(job.n);
+    stats::bump(st.ns_verify, stats::now_ns() - t0);
+    if (v.prime) {
+        if (survivor_log) {
+            std::lock_guard<std::mutex> lock(job.ticket->lock);
+            job.ticket->primes.push_back(job.tag);
+        }
     }
-};
+    else {
+        stats::bump(st.stage_pass[stats::verify_stage], 1);
+        job.ticket->failed = true;
+        done = true;
+        report_failure(job.n, v);
+    }
+    release(job.ticket);
+}
 
-WorkQueue work_queue;
+void factor_job(unsigned, FactorJob& job) {
+    static thread_local bool niced = setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19) == 0;
+    (void)niced;
+    std::string lines;
+    for (uint128_t n : *job.numbers) lines += factor::describe(n, factor::factorize(n)) + "\n";
+    {
+        std::lock_guard<std::mutex> lock(factor_lock);
+        factor_log << lines << std::flush;
+    }
+    factored += job.numbers->size();
+    delete job.numbers;
+}
 
-// Forward declarations
-uint64_t bin_exp(uint64_t base, uint64_t power, uint64_t mod);
-int fast_fib(uint64_t n, uint64_t p);
-int verify(uint64_t candidate);
+// the pool runs with the searches, started and drained around each one
+template <typename T>
+void start_verifiers() {
+    if (verify_threads > 0) verify_pool<T>.reset(new verifier::Pool<VerifyJob<T>>(1 << 16, verify_threads, verify_job<T>));
+}
 
-void worker_thread() {
-    uint64_t candidate;
-    while (work_queue.pop(candidate)) {
-        numbers_processed++;
-        current_testing = candidate; // Track current number being tested
-        
-        // Test Fermat primality first
-        if (bin_exp(2, candidate-1, candidate) == 1) {
-            // Test Fibonacci condition
-            if (fast_fib(candidate+1, candidate) == 0) {
-                try {
-                    verify(candidate);
-                    progress = candidate; // send to printing queue
+template <typename T>
+void stop_verifiers() {
+    if (!verify_pool<T>) return;
+    verify_pool<T>->drain();
+    verify_pool<T>.reset();
+}
+
+// queue depth, jobs not finished and threads at work, zeros without a pool
+void verify_backlog(uint64_t& depth, uint64_t& backlog, unsigned& active) {
+    depth = backlog = active = 0;
+    if (verify_pool<uint64_t>) {
+        depth = verify_pool<uint64_t>->depth();
+        backlog = verify_pool<uint64_t>->backlog();
+        active = verify_pool<uint64_t>->threads_active();
+    }
+    if (verify_pool<uint128_t>) {
+        depth = verify_pool<uint128_t>->depth();
+        backlog = verify_pool<uint128_t>->backlog();
+        active = verify_pool<uint128_t>->threads_active();
+    }
+}
+
+// the verify stage with a pool: every lane is queued and leaves the batch,
+// one the full queue turns away is verified here like without a pool
+template <typename T>
+void hand_off(pipeline::Batch<T>& b, RangeTicket<T>& t) {
+    for (size_t i = 0; i < b.count; ++i) {
+        t.refs++;
+        if (verify_pool<T>->try_push({b.n[i], b.tag[i], &t})) {
+            b.reject(i);
+            continue;
+        }
+        t.refs--;
+        if (!verify(b.n[i]).prime) continue;
+        b.reject(i);
+        if (survivor_log) t.survivors[b.tag[i]].flags |= catalogue::prime;
+    }
+}
+
+// runs a batch through the stage chain, whatever survives all of it is a
+// counterexample; false once one turned up
+// with a catalogue the Fermat stage logs its survivors and tags each lane
+// with its entry, the later stages fill in the flags through the tag
+template <typename T>
+bool run_chain(pipeline::Batch<T>& b, const pipeline::SieveMap<T>& map, stats::WorkerStats& st,
+               RangeTicket<T>& ticket) {
+    std::vector<catalogue::Entry>& log = ticket.survivors;
+    uint64_t entered = b.count, sieved = 0;
+    bool logged = false;    // the Fermat stage has run and tagged the lanes
+    b.keep_all();
+    for (pipeline::Stage s : stage_chain) {
+        if (b.count == 0) break;
+        size_t in = b.count;
+        uint64_t t0 = stats::now_ns();
+        if (s == stats::verify_stage && verify_pool<T>) hand_off(b, ticket);
+        else {
+            pipeline::run_stage(s, b, map);
+            if (survivor_log) {
+                for (size_t i = 0; i < b.count; ++i) {
+                    if (s == stats::sieve_stage && map.not_prime && !b.is_alive(i) &&
+                        !map.not_prime[static_cast<size_t>((b.n[i] - map.odd_lo) / 2)]) {
+                        // a prime the map dropped, it passes both tests
+                        uint8_t flags = catalogue::fib_pass | catalogue::prime;
+                        if (logged) log[b.tag[i]].flags |= flags;
+                        else log.push_back({b.n[i], flags});
+                    }
+                    if (s == stats::fermat_stage && b.is_alive(i)) {
+                        b.tag[i] = static_cast<uint32_t>(log.size());
+                        log.push_back({b.n[i], 0});
+                    }
+                    if (s == stats::fib_stage && b.is_alive(i)) log[b.tag[i]].flags |= catalogue::fib_pass;
+                    if (s == stats::verify_stage && !b.is_alive(i)) log[b.tag[i]].flags |= catalogue::prime;
                 }
-                catch (std::invalid_argument& e){
-                    done = true;
-                    work_queue.shutdown_queue();
-                    std::cout << static_cast<uint64_t>(candidate) << " failed verification, not a prime." << std::endl;
-                    return;
+                if (s == stats::fermat_stage) logged = true;
+            }
+            if (factor_pool && s == stats::fib_stage) {
+                for (size_t i = 0; i < b.count; ++i) {
+                    if (!b.is_alive(i)) ticket.composites.push_back(b.n[i]);
                 }
             }
         }
+        b.compact();
+        stats::bump(stats::stage_time(st, s), stats::now_ns() - t0);
+        stats::bump(st.stage_in[s], in);
+        stats::bump(st.stage_pass[s], b.count);
+        if (s == stats::sieve_stage) sieved = in - b.count;
+        if (s == stats::fermat_stage) stats::bump(st.fermat_passes, b.count);
+        if (s == stats::fib_stage) stats::bump(st.fib_passes, b.count);
+        if (s == stats::verify_stage) stats::bump(st.verify_calls, in);
+    }
+    stats::bump(st.sieved, sieved);
+    stats::bump(st.tested, entered - sieved);
+
+    if (b.count == 0) return true;
+    done = true;
+    for (size_t i = 0; i < b.count; ++i) report_failure(b.n[i], verify(b.n[i]));
+    return false;
+}
+
+template <typename T>
+void worker_thread(unsigned id) {
+    pin_worker(id);
+    pipeline::Batch<T> batch;
+    std::vector<uint8_t> keep, scratch, not_prime;
+    bool sieving = pipeline::position(stage_chain, stats::sieve_stage) < stage_chain.size();
+    BasicRangeScheduler<T>& sched = *scheduler<T>;
+    typename BasicRangeScheduler<T>::Range r;
+    stats::WorkerStats& st = run_stats->worker(id);
+
+    while (!done && !stop_requested && !abandon_run && sched.next(id, r)) {
+        // Sieve the odd numbers of the range in one pass
+        pipeline::SieveMap<T> map;
+        map.odd_lo = r.lo | 1;
+        if (sieving) {
+            size_t odd_count = r.hi > map.odd_lo ? static_cast<size_t>((r.hi - map.odd_lo + 1) / 2) : 0;
+            keep.resize(odd_count);
+            uint64_t t0 = stats::now_ns();
+            sieve->sieve(map.odd_lo, odd_count, keep.data());
+            if (prime_map && prime_map->covers(r.hi) && survivor_log) {
+                // the catalogue still lists the primes, the sieve stage logs them
+                not_prime.assign(odd_count, 1);
+                prime_map->strip_primes(static_cast<uint64_t>(map.odd_lo), odd_count, not_prime.data(), scratch);
+                for (size_t i = 0; i < odd_count; ++i) keep[i] &= not_prime[i];
+                map.not_prime = not_prime.data();
+            }
+            else if (prime_map && prime_map->covers(r.hi)) {
+                prime_map->strip_primes(static_cast<uint64_t>(map.odd_lo), odd_count, keep.data(), scratch);
+            }
+            stats::bump(st.ns_sieve, stats::now_ns() - t0);
+            map.keep = keep.data();
+        }
+
+        // the wheel yields the odd numbers that are ±2 mod 5, minus the
+        // residues that cannot be counterexamples, the stages do the rest
+        RangeTicket<T>* ticket = new RangeTicket<T>();
+        ticket->range = r;
+        bool failed = false;
+        wheel::Iterator<T> w(r.lo);
+        while (!failed && (batch.count = w.fill(batch.n, pipeline::width, r.hi)) > 0) {
+            failed = !run_chain(batch, map, st, *ticket);
+        }
+        if (failed) ticket->failed = true;
+        stats::set_last(st, r.hi - 1); // Track current number being tested
+        release(ticket);
+        if (failed) return;
+    }
+}
+
+// per stage of the chain: share rejected and the cost per candidate and
+// per rejection; cheap stages that reject a lot belong early in --stages
+void stage_report() {
+    stats::Snapshot snap = run_stats->snapshot();
+    std::cout << "Stages (" << pipeline::describe(stage_chain) << "):" << std::endl;
+    for (pipeline::Stage s : stage_chain) {
+        uint64_t in = snap.stage_in[s], rejected = in - snap.stage_pass[s];
+        double ns = stats::stage_ns(snap, s);
+        char line[160];
+        snprintf(line, sizeof(line), "  %-7s %14lu in  %6.2f%% rejected  %9.1f ns/candidate  %9.1f ns/rejection",
+                 stats::stage_names[s], in, in ? 100.0 * rejected / in : 0.0, in ? ns / in : 0.0,
+                 rejected ? ns / rejected : 0.0);
+        std::cout << line << std::endl;
     }
 }
 
 void printer(){
     initscr();
-    uint64_t last_progress = 0;
-    size_t last_queue_size = 0;
+    uint128_t last_frontier = 0;
     uint64_t last_processed = 0;
     auto last_time = std::chrono::steady_clock::now();
     
@@ -103,11 +407,10 @@ void printer(){
     int rate_update_counter = 0;
     
     while (printing){
-        uint64_t current_progress = progress.load();
-        size_t current_queue_size = work_queue.size();
-        uint64_t current_processed = numbers_processed.load();
+        stats::Snapshot snap = run_stats->snapshot();
+        uint128_t current_frontier = search_frontier();
+        uint64_t current_processed = snap.tested;
         uint64_t current_threads = thread_count.load();
-        uint64_t current_testing_num = current_testing.load();
         auto current_time = std::chrono::steady_clock::now();
         
         // Update smoothed rate every 10 iterations (1 second)
@@ -127,18 +430,33 @@ void printer(){
         if (elapsed > 0) {
             uint64_t processed_diff = current_processed - last_processed;
             
-            if (current_progress != last_progress || current_queue_size != last_queue_size || 
-                processed_diff > 0) {
+            if (current_frontier != last_frontier || processed_diff > 0) {
                 clear();
                 printw("Testing candidate primes...\n");
                 printw("Threads: %lu\n", current_threads);
-                printw("Currently testing: %s\n", std::to_string(current_testing_num).c_str());
-                printw("Candidates in queue: %zu\n", current_queue_size);
+                printw("Currently testing: %s\n", to_string(snap.last).c_str());
+                if (searching()) {
+                    printw("Completed up to: %s\n", to_string(current_frontier).c_str());
+                    printw("Last checkpoint: %s\n", to_string(load_wide(checkpoint_frontier, checkpoint_frontier_hi)).c_str());
+                }
                 printw("Processing rate: %.1f numbers/sec\n", smoothed_rate);
                 printw("Total processed: %s\n", std::to_string(current_processed).c_str());
+                printw("Sieved out: %s\n", std::to_string(snap.sieved).c_str());
+                printw("Fermat passes: %s, Fibonacci passes: %s\n",
+                       std::to_string(snap.fermat_passes).c_str(), std::to_string(snap.fib_passes).c_str());
+                uint64_t depth, backlog;
+                unsigned verifiers;
+                verify_backlog(depth, backlog, verifiers);
+                if (verify_threads > 0) {
+                    printw("Verify queue: %lu queued, %lu unfinished, %u of %u threads\n",
+                           depth, backlog, verifiers, verify_threads);
+                }
+                if (factor_pool) {
+                    printw("Factored: %s pseudoprimes, %lu ranges waiting\n",
+                           std::to_string(factored.load()).c_str(), factor_pool->backlog());
+                }
                 refresh();
-                last_progress = current_progress;
-                last_queue_size = current_queue_size;
+                last_frontier = current_frontier;
                 last_processed = current_processed;
                 last_time = current_time;
             }
@@ -148,222 +466,743 @@ void printer(){
     endwin();
 }
 
-int fast_fib(uint64_t n, uint64_t p) {
-    mpz_t Fn, mod;
-    mpz_inits(Fn, mod, NULL);
-    mpz_set_ui(mod, p);
-
-    mpz_t a, b, t1, t2, temp;
-    mpz_inits(a, b, t1, t2, temp, NULL);
-
-    mpz_set_ui(a, 0);
-    mpz_set_ui(b, 1);
+// writes the stats files every stats_interval seconds and, without the
+// ncurses printer, a status line to stdout
+void reporter(){
+    auto last_report = std::chrono::steady_clock::now();
+    uint64_t last_tested = 0;
+    while (printing) {
+        usleep(100000);
+        auto now = std::chrono::steady_clock::now();
+        double secs = std::chrono::duration<double>(now - last_report).count();
+        if (secs < stats_interval && printing) continue;
 
-    for (int i = 63 - __builtin_clzll(n); i >= 0; --i) {
-        // F(2k) = F(k) * [2*F(k+1) − F(k)]
-        // F(2k+1) = F(k)^2 + F(k+1)^2
+        stats::Snapshot snap = run_stats->snapshot();
+        if (!stats_json_path.empty()) stats::write_file(stats_json_path, stats::to_json(snap));
+        if (!stats_prom_path.empty()) stats::write_file(stats_prom_path, stats::to_prometheus(snap));
+        if (headless) {
+            *status << "tested " << snap.tested << " (" << static_cast<uint64_t>((snap.tested - last_tested) / secs)
+                    << "/s), sieved " << snap.sieved << ", fermat passes " << snap.fermat_passes
+                    << ", at " << to_string(snap.last);
+            if (searching()) *status << ", complete below " << to_string(search_frontier());
+            uint64_t depth, backlog;
+            unsigned verifiers;
+            verify_backlog(depth, backlog, verifiers);
+            if (backlog > 0) *status << ", verify backlog " << backlog;
+            if (factor_pool && factor_pool->backlog() > 0) *status << ", factor backlog " << factor_pool->backlog();
+            *status << std::endl;
+        }
+        last_tested = snap.tested;
+        last_report = now;
+    }
+}
 
-        // t1 = 2*b - a
-        mpz_mul_ui(t1, b, 2);
-        mpz_sub(t1, t1, a);
-        mpz_mod(t1, t1, mod);
+// printer and reporter threads, both stop once printing is cleared
+std::vector<std::thread> start_monitors(){
+    std::vector<std::thread> threads;
+    if (!headless) threads.emplace_back(printer);
+    threads.emplace_back(reporter);
+    return threads;
+}
 
-        // t1 = a * t1
-        mpz_mul(t1, a, t1);
-        mpz_mod(t1, t1, mod);  // t1 = F(2k)
+void stop_monitors(std::vector<std::thread>& threads){
+    printing = false;
+    for (auto& t : threads) t.join();
+}
 
-        // t2 = a^2 + b^2
-        mpz_mul(t2, a, a);
-        mpz_mul(temp, b, b);
-        mpz_add(t2, t2, temp);
-        mpz_mod(t2, t2, mod);  // t2 = F(2k+1)
+// --psp-file mode: every base-2 pseudoprime is composite, so one that is
+// ±2 mod 5 and passes the Fibonacci condition is a counterexample and
+// the Fermat test never has to run
+void psp_worker(unsigned id, const psplist::Reader* list, std::atomic_uint64_t* next_block,
+                uint64_t last_block, uint64_t lo, uint64_t hi) {
+    pin_worker(id);
+    stats::WorkerStats& st = run_stats->worker(id);
+    std::vector<uint64_t> values;
+    uint64_t b;
+    while (!done && !stop_requested && (b = (*next_block)++) < last_block) {
+        if (!list->decode(b, values)) {
+            std::cout << "Block " << b << " of the pseudoprime list failed its checksum" << std::endl;
+            list_error = true;
+            stop_requested = true;
+            return;
+        }
+        uint64_t tested = 0;
+        for (uint64_t candidate : values) {
+            if (candidate < lo || candidate >= hi) continue;
+            if (candidate % 5 != 2 && candidate % 5 != 3) continue;
+            tested++;
+            Montgomery mont(candidate);
+            if (lucas_fib(mont, candidate+1) != 0) continue;
 
-        if ((n >> i) & 1) {
-            mpz_set(a, t2);        // F(n) = F(2k+1)
-            mpz_add(b, t1, t2);    // F(n+1) = F(2k) + F(2k+1)
-            mpz_mod(b, b, mod);
-        } else {
-            mpz_set(a, t1);        // F(n) = F(2k)
-            mpz_set(b, t2);        // F(n+1) = F(2k+1)
+            // a prime here means a damaged list, not a counterexample
+            stats::bump(st.fib_passes, 1);
+            stats::bump(st.verify_calls, 1);
+            Verdict v = verify(candidate);
+            if (v.prime) {
+                std::cout << candidate << " in the pseudoprime list is prime, skipping" << std::endl;
+                continue;
+            }
+            done = true;
+            report_failure(candidate, v);
+            return;
         }
+        stats::bump(st.tested, tested);
+        stats::set_last(st, values.back());
     }
+}
 
-    mpz_set(Fn, a);  // F(n) mod mod
+int run_psp_list(const std::string& path, uint64_t lo, uint64_t hi, unsigned num_threads) {
+    psplist::Reader list;
+    if (!list.open(path)) {
+        std::cout << "Could not open pseudoprime list " << path << " (lists from before the index checksum are refused)" << std::endl;
+        return 1;
+    }
+    std::cout << "Checking " << list.count() << " base-2 pseudoprimes from " << path << std::endl;
+    if (list.blocks() == 0) {
+        std::cout << "No counterexample among the listed pseudoprimes." << std::endl;
+        return 0;
+    }
 
-    mpz_clears(a, b, t1, t2, temp, NULL);
-    int result = mpz_get_ui(Fn);
+    uint64_t first_block = list.block_for(lo);
+    uint64_t last_block = list.block_for(hi == 0 ? 0 : hi - 1) + 1;
+    std::atomic_uint64_t next_block(first_block);
 
-    mpz_clears(Fn, mod, NULL);
-    return result;
+    std::vector<std::thread> monitors = start_monitors();
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < num_threads; ++i) {
+        workers.emplace_back(psp_worker, i, &list, &next_block, last_block, lo, hi);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    stop_monitors(monitors);
+
+    if (list_error) return 1;
+    if (stop_requested && !done) {
+        std::cout << "Stopped at block " << next_block.load() << std::endl;
+    }
+    else if (!done) {
+        std::cout << "No counterexample among the listed pseudoprimes." << std::endl;
+    }
+    return 0;
 }
 
-// fast integer square root
-uint64_t isqrt(uint64_t n){
-    if (n == 0) return 0;
-    if (n < 4) return 1;
-    
-    // Use bit manipulation for faster initial approximation
-    uint64_t x = 1ULL << ((63 - __builtin_clzll(n)) / 2);
-    
-    // Newton-Raphson iteration (usually converges in 2-3 steps)
-    uint64_t y = (x + n / x) / 2;
-    while (y < x) {
-        x = y;
-        y = (x + n / x) / 2;
+// --stream mode: chunks of the list in input order, results through the
+// reorder buffer; a counterexample is reported and the stream goes on
+std::atomic_uint64_t stream_found;
+
+void stream_worker(unsigned id, stream::Source* source, stream::Reorder* out, bool binary) {
+    pin_worker(id);
+    stats::WorkerStats& st = run_stats->worker(id);
+    stream::Chunk chunk;
+    stream::Scratch scratch;
+    while (!stop_requested && source->next(chunk)) {
+        out->wait_turn(chunk.seq);
+        stream::decode(chunk, binary, scratch);
+        stream::test(scratch.values, scratch.outcome, st);
+        for (size_t i = 0; i < scratch.values.size(); ++i) {
+            if (scratch.outcome[i] != stream::counterexample) continue;
+            stream_found++;
+            report_failure(scratch.values[i], verify(scratch.values[i]));
+        }
+        if (!scratch.values.empty()) stats::set_last(st, scratch.values.back());
+        out->put(chunk.seq, stream::format(chunk, scratch));
     }
-    return x;
 }
 
-// deterministic primality verification
-// using wheel factorization mod 30 with unrolled loop for speed
-int verify(uint64_t candidate){
+int run_stream(const std::string& path, bool binary, const std::string& out_path, unsigned num_threads) {
+    stream::Source source;
+    if (!source.open(path, binary)) {
+        *status << "Could not open " << path << std::endl;
+        return 1;
+    }
+    int fd = out_path.empty() ? 1 : open(out_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        *status << "Could not open " << out_path << std::endl;
+        return 1;
+    }
+    // a few chunks per thread in flight keeps every core busy behind a slow one
+    stream::Reorder out(fd, 4 * num_threads);
 
-    // Handle special cases for small primes
-    if (candidate == 3 || candidate == 5 || candidate == 7 || 
-        candidate == 11 || candidate == 13 || candidate == 17 || 
-        candidate == 19 || candidate == 23 || candidate == 29) {
+    std::vector<std::thread> monitors = start_monitors();
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < num_threads; ++i) {
+        workers.emplace_back(stream_worker, i, &source, &out, binary);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    stop_monitors(monitors);
+    if (fd != 1) close(fd);
+
+    if (source.failed() || out.failed()) {
+        *status << (source.failed() ? "Reading " + path : "Writing the results") << " failed" << std::endl;
         return 1;
     }
-    
-    if (candidate % 3 == 0) {
-        std::cout << candidate << std::endl;
-        throw std::invalid_argument(" not a prime\n");
+    if (source.trailing()) *status << "Ignored " << source.trailing() << " bytes past the last whole record" << std::endl;
+    *status << (stop_requested ? "Stopped after " : "Tested ") << run_stats->snapshot().tested << " odd numbers, "
+            << stream_found << " counterexample(s)" << std::endl;
+    return stream_found ? 2 : 0;
+}
+
+void handle_stop(int){
+    stop_requested = true;
+}
+
+// writes the scheduler frontier to path, atomically replacing the old file
+template <typename T>
+bool flush_checkpoint(const std::string& path){
+    Checkpoint c;
+    c.start = scheduler<T>->range_start();
+    c.end = scheduler<T>->range_end();
+    c.width = scheduler<T>->block_width();
+    scheduler<T>->snapshot(c.frontier, c.done);
+    // blocks of the ranges in the snapshot are written, make them durable first
+    if (survivor_log && !survivor_log->sync()) return false;
+    if (!write_checkpoint(path, c)) return false;
+    store_wide(checkpoint_frontier, checkpoint_frontier_hi,
+               std::min(c.start + static_cast<uint128_t>(c.frontier) * c.width, c.end));
+    return true;
+}
+
+template <typename T>
+void checkpointer(std::string path, unsigned interval){
+    auto last_flush = std::chrono::steady_clock::now();
+    while (checkpointing) {
+        auto now = std::chrono::steady_clock::now();
+        if (std::chrono::duration_cast<std::chrono::seconds>(now - last_flush).count() >= interval) {
+            flush_checkpoint<T>(path);
+            last_flush = now;
+        }
+        usleep(100000);
     }
+}
 
-    uint64_t sup = isqrt(candidate);
+// the scheduled search over [start, end), T wide enough for end
+template <typename T>
+int run_search(T start, T end, unsigned num_threads, const std::string& checkpoint_path,
+               unsigned checkpoint_interval, bool resume) {
+    scheduler<T>.reset(new BasicRangeScheduler<T>(start, end, num_threads));
+    scheduler<T>->partition(worker_nodes(num_threads));
+    store_wide(checkpoint_frontier, checkpoint_frontier_hi, start);
 
-    for (uint64_t base = 0; base <= sup; base += 30){
-        uint64_t d = 0;
+    if (resume) {
+        Checkpoint c;
+        if (!read_checkpoint(checkpoint_path, c)) {
+            std::cout << "Could not read checkpoint " << checkpoint_path << " (files from before the wheel generator are refused)" << std::endl;
+            return 1;
+        }
+        if (c.start != start || c.end != scheduler<T>->range_end() || c.width != scheduler<T>->block_width()) {
+            std::cout << "Checkpoint " << checkpoint_path << " is for a different search range" << std::endl;
+            return 1;
+        }
+        scheduler<T>->restore(c.frontier, c.done);
+        store_wide(checkpoint_frontier, checkpoint_frontier_hi, scheduler<T>->frontier());
+        std::cout << "Resuming from " << to_string(scheduler<T>->frontier()) << std::endl;
+    }
 
-        d = base + 29;
-        if (d <= sup && d != candidate && candidate % d == 0) goto fail;
+    // Flush a final checkpoint on the way out instead of dying mid-block
+    checkpointing = true;
+    std::thread checkpoint_thread(checkpointer<T>, checkpoint_path, checkpoint_interval);
 
-        d = base + 23;
-        if (d != candidate && candidate % d == 0) goto fail; 
+    std::vector<std::thread> monitors = start_monitors();
+    start_verifiers<T>();
+    
+    // Start worker threads, each pulls its own ranges from the scheduler
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < num_threads; ++i) {
+        workers.emplace_back(worker_thread<T>, i);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    // queued survivors hold their ranges open, finish them for the checkpoint
+    stop_verifiers<T>();
+    
+    checkpointing = false;
+    checkpoint_thread.join();
+    bool flushed = flush_checkpoint<T>(checkpoint_path);
 
-        d = base + 19;
-        if (d != candidate && candidate % d == 0) goto fail; 
+    stop_monitors(monitors);
+    stage_report();
+    
+    if (!flushed) {
+        std::cout << "Could not write checkpoint " << checkpoint_path << std::endl;
+    }
+    if (stop_requested && !done) {
+        std::cout << "Stopped, checkpoint at " << to_string(load_wide(checkpoint_frontier, checkpoint_frontier_hi)) << std::endl;
+    }
+    else if (!done) {
+        std::cout << "All candidates below " << to_string(scheduler<T>->range_end()) << " checked." << std::endl;
+    }
+    
+    return 0;
+}
 
-        d = base + 17;
-        if (d != candidate && candidate % d == 0) goto fail;
-        
-        d = base + 13;
-        if (d != candidate && candidate % d == 0) goto fail;
+// --worker mode: runs one leased unit on the usual worker threads while
+// this thread heartbeats the frontier, false once the worker should stop
+template <typename T>
+bool run_unit(lease::Client& client, const lease::Unit& unit, unsigned num_threads, unsigned heartbeat) {
+    scheduler<T>.reset(new BasicRangeScheduler<T>(static_cast<T>(unit.lo), static_cast<T>(unit.hi), num_threads));
+    scheduler<T>->partition(worker_nodes(num_threads));
+    uint64_t processed_before = run_stats->snapshot().tested;
+    std::atomic_bool running(true);
+    bool coordinator_gone = false;
+    abandon_run = false;
 
-        d = base + 11;
-        if (d != candidate && candidate % d == 0) goto fail;
+    std::thread heartbeat_thread([&] {
+        auto last_beat = std::chrono::steady_clock::now();
+        while (running && !abandon_run) {
+            usleep(100000);
+            auto now = std::chrono::steady_clock::now();
+            if (std::chrono::duration_cast<std::chrono::seconds>(now - last_beat).count() < heartbeat) continue;
+            if (!client.heartbeat(unit.id, scheduler<T>->frontier(), coordinator_gone)) abandon_run = true;
+            last_beat = now;
+        }
+    });
+    start_verifiers<T>();
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < num_threads; ++i) {
+        workers.emplace_back(worker_thread<T>, i);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    stop_verifiers<T>();
+    running = false;
+    heartbeat_thread.join();
 
-        d = base + 7;
-        if (d != candidate && candidate % d == 0) goto fail;
+    if (done) {
+        std::lock_guard<std::mutex> lock(failure_mutex);
+        client.hit(unit.id, failed_candidate, failed_verdict.witness, failed_verdict.factor);
+        return false;
+    }
+    if (coordinator_gone) {
+        std::cout << "Lost the coordinator" << std::endl;
+        return false;
+    }
+    if (abandon_run) {
+        std::cout << "Lease on unit " << unit.id << " expired, dropping it" << std::endl;
+        return true;
+    }
+    if (stop_requested) return false;
+    if (survivor_log && !survivor_log->sync()) {
+        std::cout << "Could not sync the catalogue" << std::endl;
+        return false;
+    }
+    if (!client.complete(unit.id, run_stats->snapshot().tested - processed_before)) {
+        std::cout << "Could not report unit " << unit.id << " complete" << std::endl;
+        return false;
+    }
+    return true;
+}
 
-        d = base + 1;
-        if (d > 5 && d != candidate && candidate % d == 0) goto fail;
-      
+int run_worker(const std::string& addr, unsigned num_threads, unsigned heartbeat) {
+    char host[256] = "worker";
+    gethostname(host, sizeof(host) - 1);
+    lease::Client client;
+    if (!client.connect(addr, std::string(host) + "-" + std::to_string(getpid()))) {
+        std::cout << "Could not reach a coordinator at " << addr << std::endl;
+        return 1;
     }
 
-    return 1;
+    // workers run unattended, progress goes to stdout and the stats files
+    headless = true;
+    std::vector<std::thread> monitors = start_monitors();
+    int result = 0;
+    while (!done && !stop_requested) {
+        lease::Unit unit;
+        unsigned wait = 0;
+        lease::Client::Status status = client.lease(unit, wait);
+        if (status == lease::Client::FINISHED) break;
+        if (status == lease::Client::LOST) {
+            std::cout << "Lost the coordinator" << std::endl;
+            result = 1;
+            break;
+        }
+        if (status == lease::Client::WAIT) {
+            sleep(wait);
+            continue;
+        }
 
-    fail:
-        std::cout << candidate << std::endl;
-        throw std::invalid_argument(" not a prime\n");
+        std::cout << "Unit " << unit.id << ": [" << to_string(unit.lo) << ", " << to_string(unit.hi) << ")" << std::endl;
+        bool more = unit.hi > static_cast<uint128_t>(UINT64_MAX)
+            ? run_unit<uint128_t>(client, unit, num_threads, heartbeat)
+            : run_unit<uint64_t>(client, unit, num_threads, heartbeat);
+        if (!more) break;
+    }
+    stop_monitors(monitors);
+    stage_report();
+    std::cout << "Worker finished, " << run_stats->snapshot().tested << " candidates tested." << std::endl;
+    return result;
 }
 
-// computes base^power % mod using binary exponentiation
-// essentially Fermat primality test with base 2
-uint64_t bin_exp(uint64_t base, uint64_t power, uint64_t mod){
-    mpz_t result, b, m;
-    mpz_inits(result, b, m, NULL);
-    
-    mpz_set_ui(result, 1);
-    mpz_set_ui(b, base);
-    mpz_set_ui(m, mod);
-    
-    mpz_mod(b, b, m);  // base % mod
-    
-    while (power > 0){
-        if (power & 1){
-            mpz_mul(result, result, b);
-            mpz_mod(result, result, m);
+// --scaling: the start of the default range at 1, 2, 4, ... threads for a
+// fixed time each, per-thread throughput shows where more cores stop paying
+int run_scaling(unsigned max_threads, unsigned seconds) {
+    std::vector<unsigned> counts;
+    for (unsigned t = 1; t < max_threads; t *= 2) counts.push_back(t);
+    counts.push_back(max_threads);
+
+    std::cout << "threads  candidates/sec  per thread  efficiency" << std::endl;
+    double single = 0;
+    for (unsigned t : counts) {
+        scheduler<uint64_t>.reset(new RangeScheduler(search_start, search_end, t));
+        scheduler<uint64_t>->partition(worker_nodes(t));
+        abandon_run = false;
+        uint64_t before = run_stats->snapshot().tested;
+        auto t0 = std::chrono::steady_clock::now();
+
+        start_verifiers<uint64_t>();
+        std::vector<std::thread> workers;
+        for (unsigned int i = 0; i < t; ++i) {
+            workers.emplace_back(worker_thread<uint64_t>, i);
+        }
+        while (!stop_requested && std::chrono::steady_clock::now() - t0 < std::chrono::seconds(seconds)) {
+            usleep(100000);
         }
-        mpz_mul(b, b, b);
-        mpz_mod(b, b, m);
-        power >>= 1;
+        abandon_run = true;
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        stop_verifiers<uint64_t>();
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        double rate = (run_stats->snapshot().tested - before) / elapsed;
+        if (t == 1) single = rate;
+        printf("%7u  %14.0f  %10.0f  %9.1f%%\n", t, rate, rate / t, single > 0 ? 100.0 * rate / (t * single) : 0.0);
+        fflush(stdout);
+        if (stop_requested || done) break;
     }
-    
-    uint64_t res = mpz_get_ui(result);
-    mpz_clears(result, b, m, NULL);
-    return res;
+    scheduler<uint64_t>.reset();
+    return 0;
 }
 
 int main(int argc, char *argv[]){    // input: an odd integer p
 
-    // Default to 1 thread, allow command line override
-    unsigned int num_threads = 1;
+    // Default to one thread per CPU we may run on, allow command line override
+    unsigned int num_threads = 0;
+    uint32_t sieve_bound = 1 << 16; // sieving primes below this, 0 disables
+    uint64_t prime_bound = PrimeMap::default_bound;  // prime map exact below its square, 0 disables
+    std::string checkpoint_path = "psw.ckpt";
+    unsigned checkpoint_interval = 60; // seconds between flushes
+    bool resume = false;
+    std::string psp_file;
+    std::string catalogue_path;  // empty: Fermat survivors are not kept
+    std::string factors_path;    // empty: pseudoprimes are not factored
+    unsigned factor_threads = 1;
+    std::string stream_path, output_path;  // --stream input, results to stdout unless --output
+    bool stream_binary = false;
+    uint64_t range_lo = 0, range_hi = UINT64_MAX; // --psp-file only
+    uint128_t start = search_start, end = search_end;
+    bool pin = false, skip_smt = false, show_topology = false;
+    unsigned scaling_seconds = 0;  // --scaling, seconds per thread count
+    std::string worker_addr;  // coordinator to lease units from
+    unsigned heartbeat = 10;  // seconds between heartbeats in --worker mode
+    int verify_limit = -1;    // --verify-threads, one per search thread by default
+    std::string kernel_spec;  // --kernel, empty: the best the CPU reports
+    bool calibrate = false;   // --calibrate, time the kernel variants instead
     
-    if (argc > 1) {
-        num_threads = std::stoi(argv[1]);
-        if (num_threads < 1) num_threads = 1;
-        if (num_threads > 16) num_threads = 16; // Allow up to 16 threads via command line
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (arg == "--sieve-bound" && a + 1 < argc) {
+            sieve_bound = std::min<unsigned long>(std::stoul(argv[++a]), UINT32_MAX);
+            continue;
+        }
+        if (arg == "--prime-map-bound" && a + 1 < argc) {
+            prime_bound = std::min(std::stoull(argv[++a]), 1ULL << 32);
+            continue;
+        }
+        if (arg == "--checkpoint" && a + 1 < argc) {
+            checkpoint_path = argv[++a];
+            continue;
+        }
+        if (arg == "--checkpoint-interval" && a + 1 < argc) {
+            checkpoint_interval = std::stoul(argv[++a]);
+            continue;
+        }
+        if (arg == "--stages" && a + 1 < argc) {
+            if (!pipeline::parse(argv[++a], stage_chain)) {
+                std::cout << "Bad --stages " << argv[a] << ", expected fermat, fib and verify (and optionally sieve)"
+                          << " in any order, comma separated" << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (arg == "--kernel" && a + 1 < argc) {
+            kernel_spec = argv[++a];
+            continue;
+        }
+        if (arg == "--calibrate") {
+            calibrate = true;
+            continue;
+        }
+        if (arg == "--verify-threads" && a + 1 < argc) {
+            verify_limit = std::stoi(argv[++a]);
+            continue;
+        }
+        if (arg == "--catalogue" && a + 1 < argc) {
+            catalogue_path = argv[++a];
+            continue;
+        }
+        if (arg == "--factors" && a + 1 < argc) {
+            factors_path = argv[++a];
+            continue;
+        }
+        if (arg == "--factor-threads" && a + 1 < argc) {
+            factor_threads = std::max(1UL, std::stoul(argv[++a]));
+            continue;
+        }
+        if ((arg == "--stream" || arg == "--stream-binary") && a + 1 < argc) {
+            stream_binary = arg == "--stream-binary";
+            stream_path = argv[++a];
+            continue;
+        }
+        if (arg == "--output" && a + 1 < argc) {
+            output_path = argv[++a];
+            continue;
+        }
+        if (arg == "--psp-file" && a + 1 < argc) {
+            psp_file = argv[++a];
+            continue;
+        }
+        if (arg == "--range" && a + 2 < argc) {
+            range_lo = std::stoull(argv[++a]);
+            range_hi = std::stoull(argv[++a]);
+            continue;
+        }
+        if ((arg == "--start" || arg == "--end") && a + 1 < argc) {
+            if (!parse_u128(argv[++a], arg == "--start" ? start : end)) {
+                std::cout << "Bad " << arg << " value " << argv[a] << ", expected a number below 2^128" << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (arg == "--worker" && a + 1 < argc) {
+            worker_addr = argv[++a];
+            continue;
+        }
+        if (arg == "--heartbeat" && a + 1 < argc) {
+            heartbeat = std::stoul(argv[++a]);
+            continue;
+        }
+        if (arg == "--headless") {
+            headless = true;
+            continue;
+        }
+        if (arg == "--stats-json" && a + 1 < argc) {
+            stats_json_path = argv[++a];
+            continue;
+        }
+        if (arg == "--stats-prom" && a + 1 < argc) {
+            stats_prom_path = argv[++a];
+            continue;
+        }
+        if (arg == "--stats-interval" && a + 1 < argc) {
+            stats_interval = std::max(1UL, std::stoul(argv[++a]));
+            continue;
+        }
+        if (arg == "--pin") {
+            pin = true;
+            continue;
+        }
+        if (arg == "--no-smt") {
+            skip_smt = true;
+            continue;
+        }
+        if (arg == "--topology") {
+            show_topology = true;
+            continue;
+        }
+        if (arg == "--scaling" && a + 1 < argc) {
+            scaling_seconds = std::stoul(argv[++a]);
+            continue;
+        }
+        if (arg == "--resume") {
+            resume = true;
+            continue;
+        }
+        num_threads = std::max(1, std::stoi(arg));
+    }
+
+    std::vector<topology::Cpu> cpus = topology::discover();
+    std::vector<topology::Cpu> order = topology::placement(cpus, skip_smt);
+    if (show_topology) {
+        std::cout << cpus.size() << " CPUs on " << topology::count_nodes(cpus) << " NUMA node(s), worker order:" << std::endl;
+        for (const topology::Cpu& c : order) {
+            std::cout << "  cpu " << c.cpu << ": node " << c.node << ", package " << c.package
+                      << ", core " << c.core << (c.sibling ? ", SMT sibling" : "") << std::endl;
+        }
+        return 0;
+    }
+    if (pin) placement = order;
+    if (num_threads == 0) num_threads = std::max<size_t>(1, order.size());
+    num_threads = std::min(num_threads, stats::max_workers);
+
+    // results own stdout in stream mode unless they go to a file
+    if (!stream_path.empty()) {
+        headless = true;
+        if (output_path.empty()) status = &std::cerr;
     }
     
-    std::cout << "Using " << num_threads << " computation threads" << std::endl;
-    std::cout << "Starting PSW conjecture testing..." << std::endl;
+    // kernels: cpuid's pick, timed on the first candidates of the range
+    // with --calibrate, and --kernel over either
+    if (calibrate) {
+        std::vector<uint64_t> sample(8192);
+        uint64_t from = start > UINT64_MAX / 2 ? UINT64_MAX / 2 : static_cast<uint64_t>(start);
+        wheel::Iterator<uint64_t> w(from);
+        sample.resize(w.fill(sample.data(), sample.size(), UINT64_MAX));
+        *status << "Kernel timings per candidate near " << from << ":" << std::endl << kernels::calibrate(sample);
+    }
+    std::string kernel_error;
+    if (!kernel_spec.empty() && !kernels::select(kernel_spec, kernel_error)) {
+        std::cout << "Bad --kernel " << kernel_spec << ": " << kernel_error << std::endl;
+        return 1;
+    }
+    *status << "Kernels: " << kernels::describe() << std::endl;
+    *status << "Using " << num_threads << " computation threads" << std::endl;
+    *status << "Starting PSW conjecture testing..." << std::endl;
 
-    std::thread printer_thread(printer);
-    progress = 0;
-    numbers_processed = 0;
-    current_testing = 0;
+    // the pool takes the verify stage off the search threads when it ends
+    // the chain, the stats blocks after the search threads' are its own
+    search_threads = num_threads;
+    if (stage_chain.empty()) pipeline::parse("sieve,fermat,fib,verify", stage_chain);
+    verify_threads = stage_chain.back() != stats::verify_stage ? 0 : verify_limit < 0 ? num_threads : verify_limit;
+    verify_threads = std::min(verify_threads, stats::max_workers - num_threads);
+    run_stats.reset(new stats::Publisher(num_threads + verify_threads));
     thread_count = num_threads;
     printing = true;
     done = false;
-    
-    // Start worker threads
-    std::vector<std::thread> workers;
-    for (unsigned int i = 0; i < num_threads; ++i) {
-        workers.emplace_back(worker_thread);
+    stop_requested = false;
+    list_error = false;
+    abandon_run = false;
+    signal(SIGINT, handle_stop);
+    signal(SIGTERM, handle_stop);
+
+    if (!psp_file.empty()) {
+        return run_psp_list(psp_file, range_lo, range_hi, num_threads);
     }
-    
-    // Generate numbers and maintain target queue size
-    int sign = -1;
-    const size_t target_queue_size = 10000; // Target number of candidates in queue
-    
-    for (uint64_t i = 4294967295ULL; i < 18446744073709551615ULL && !done; i += (5 + sign)){
-        // Wait if queue is too full
-        while (work_queue.size() > target_queue_size * 2 && !done) {
-            usleep(100); // Short wait
+    if (!stream_path.empty()) {
+        return run_stream(stream_path, stream_binary, output_path, num_threads);
+    }
+
+    // a catalogue lists every Fermat survivor and --factors takes the ones
+    // the Fibonacci stage rejects, so either way the sieve drops no more
+    // than Fermat would
+    sieve.reset(new CongruenceSieve(sieve_bound, !catalogue_path.empty() || !factors_path.empty()));
+    if (prime_bound > 0 && pipeline::position(stage_chain, stats::sieve_stage) < stage_chain.size()) {
+        prime_map.reset(new PrimeMap(prime_bound));
+        std::cout << "Prime map: " << prime_map->primes() << " base primes, primes skipped below "
+                  << to_string(static_cast<uint128_t>(prime_map->bound()) * prime_map->bound()) << std::endl;
+    }
+    if (!catalogue_path.empty()) {
+        // the catalogue lists Fermat survivors and what the later tests said
+        size_t f = pipeline::position(stage_chain, stats::fermat_stage);
+        size_t l = pipeline::position(stage_chain, stats::fib_stage);
+        if (f > l || l > pipeline::position(stage_chain, stats::verify_stage)) {
+            std::cout << "--catalogue needs fermat, fib and verify in that order in --stages" << std::endl;
+            return 1;
         }
-        
-        work_queue.push(i);
-        sign *= -1;
-        
-        // Small delay to let workers process
-        if (work_queue.size() > target_queue_size) {
-            usleep(50);
+        survivor_log.reset(new catalogue::Writer());
+        if (!survivor_log->open(catalogue_path)) {
+            std::cout << "Could not open catalogue " << catalogue_path << " (catalogues from before the header checksum are refused)" << std::endl;
+            return 1;
         }
     }
-    
-    // Shutdown work queue and wait for workers
-    work_queue.shutdown_queue();
-    for (auto& worker : workers) {
-        worker.join();
+
+    if (!factors_path.empty()) {
+        // the pseudoprimes are the Fermat survivors the Fibonacci stage rejects
+        if (pipeline::position(stage_chain, stats::fermat_stage) > pipeline::position(stage_chain, stats::fib_stage)) {
+            std::cout << "--factors needs fermat before fib in --stages" << std::endl;
+            return 1;
+        }
+        factor_log.open(factors_path, std::ios::app);
+        if (!factor_log) {
+            std::cout << "Could not open " << factors_path << std::endl;
+            return 1;
+        }
+        factor_pool.reset(new verifier::Pool<FactorJob>(1 << 12, factor_threads, factor_job));
     }
-    
-    printing = false;
-    printer_thread.join();
-    
-    if (!done) {
-        std::cout << "All possible integers up to 64-bit limit checked." << std::endl;
+
+    int result;
+    if (scaling_seconds > 0) {
+        result = run_scaling(num_threads, scaling_seconds);
+    }
+    else if (!worker_addr.empty()) {
+        result = run_worker(worker_addr, num_threads, heartbeat);
+    }
+    else if (end > static_cast<uint128_t>(UINT64_MAX)) {
+        result = run_search<uint128_t>(start, end, num_threads, checkpoint_path, checkpoint_interval, resume);
+    }
+    else {
+        result = run_search<uint64_t>(static_cast<uint64_t>(start), static_cast<uint64_t>(end),
+                                      num_threads, checkpoint_path, checkpoint_interval, resume);
     }
-    
-    return 0;
 
+    if (factor_pool) {
+        factor_pool->drain();
+        factor_pool.reset();
+        std::cout << "Factored " << factored << " pseudoprimes into " << factors_path;
+        if (factor_skipped) std::cout << ", " << factor_skipped << " skipped with the queue full";
+        std::cout << std::endl;
+    }
+    return result;
 }
 
 // MAC COMPILE:
-// clang++ main.cpp -o main -I /opt/homebrew/include -L/opt/homebrew/lib -lgmp -lncurses -O3 -ffast-math -march=native
+// clang++ main.cpp -o main -I /opt/homebrew/include -L/opt/homebrew/lib -lncurses -O3 -ffast-math -march=native
 
 // LINUX COMPILE:
-// g++ main.cpp -o main -lgmp -lncurses -O3 -ffast-math -march=native
+// g++ main.cpp -o main -lncurses -O3 -ffast-math -march=native
+
+// portable build for a mixed fleet: the Fermat, Fibonacci and verify
+// kernels still use AVX2/AVX-512/IFMA wherever cpuid reports them
+// g++ main.cpp -o main -lncurses -O3 -ffast-math
+
+// without a terminal, stats for a scraper (a running search also shows up
+// as /dev/shm/psw-stats-<pid>, see psw_stats.cpp):
+// ./main 8 --headless --stats-prom /var/lib/node_exporter/psw.prom
+
+// pinned one thread per physical core, split by NUMA node, on every CPU
+// the affinity mask allows; --topology shows the order, --scaling 10 the
+// throughput at 1, 2, 4, ... threads
+// ./main --pin --no-smt
+
+// as a worker of ./coordinator (see coordinator.cpp):
+// ./main 8 --worker 127.0.0.1:7433
+
+// a different stage order, the stage report at the end shows what each
+// one rejects and at what cost:
+// ./main 8 --stages fermat,sieve,fib,verify
+
+// a list of numbers instead of a range, one result line per number in
+// input order (text from a file or stdin, or a file of uint64 records):
+// ./main 8 --stream candidates.txt --output results.txt
+// generate | ./main --stream - > results.txt
+// ./main --stream-binary candidates.u64 --output results.txt
+
+// kernel variants timed at startup instead of cpuid's pick, or forced:
+// ./main 8 --calibrate
+// ./main 8 --kernel avx2
+// ./main 8 --kernel fermat=ifma,verify=generic
+
+// primes skipped by the sieve up to 2^64 instead of 2^48 (base primes up
+// to 2^32, 200 MB and a slower pass per range above 2^48):
+// ./main 8 --prime-map-bound 4294967296
+
+// verification on at most 4 threads of its own instead of one per search
+// thread, or on the search threads themselves with 0:
+// ./main 8 --verify-threads 4
+
+// keeping every Fermat survivor for later tests (see survivors.cpp):
+// ./main 8 --catalogue psw.cat
+
+// the base-2 pseudoprimes factored on the side, one line each with ord_p(2)
+// and z(p) of every prime, "561 = 3 [2, 4] * 11 [10, 10] * 17 [8, 9]":
+// ./main 8 --factors psp.txt --factor-threads 2
+
+// past 2^64:
+// ./main 8 --start 18446744073709551616 --end 18446744073709551616000
 
 // current progress: 9223372036854775807 / 18446744073709551615
 
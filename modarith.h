@@ -0,0 +1,293 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// header-only modular arithmetic for odd moduli of one or two 64-bit words
+// values are kept in Montgomery form (x * R mod n) so that every
+// multiplication is a fixed number of 64x64->128 products plus a REDC,
+// no division and no heap allocation
+// MontgomeryT<uint64_t> uses R = 2^64, MontgomeryT<uint128_t> R = 2^128;
+// the kernels below are templates over either, so both widths share them
+
+typedef unsigned __int128 uint128_t;
+
+inline int top_bit(uint64_t x){ return 63 - __builtin_clzll(x); }
+inline int top_bit(uint128_t x){
+    uint64_t hi = static_cast<uint64_t>(x >> 64);
+    return hi ? 127 - __builtin_clzll(hi) : 63 - __builtin_clzll(static_cast<uint64_t>(x));
+}
+
+inline int trailing_zeros(uint64_t x){ return __builtin_ctzll(x); }
+inline int trailing_zeros(uint128_t x){
+    uint64_t lo = static_cast<uint64_t>(x);
+    return lo ? __builtin_ctzll(lo) : 64 + __builtin_ctzll(static_cast<uint64_t>(x >> 64));
+}
+
+inline std::string to_string(uint128_t x){
+    if (x == 0) return "0";
+    std::string s;
+    while (x > 0) {
+        s.insert(s.begin(), static_cast<char>('0' + static_cast<int>(x % 10)));
+        x /= 10;
+    }
+    return s;
+}
+
+// decimal string to 128 bits, false on anything else or overflow
+inline bool parse_u128(const std::string& s, uint128_t& out){
+    if (s.empty()) return false;
+    uint128_t v = 0;
+    for (char c : s) {
+        if (c < '0' || c > '9') return false;
+        // 2^128 - 1 = 10 * top + 5
+        const uint128_t top = ~static_cast<uint128_t>(0) / 10;
+        if (v > top || (v == top && c > '5')) return false;
+        v = v * 10 + (c - '0');
+    }
+    out = v;
+    return true;
+}
+
+template <typename T> struct MontgomeryT;
+
+template <> struct MontgomeryT<uint64_t> {
+    typedef uint64_t word;
+
+    uint64_t n;     // modulus, must be odd
+    uint64_t inv;   // n^-1 mod 2^64
+    uint64_t one;   // 2^64 mod n, i.e. 1 in Montgomery form
+
+    explicit MontgomeryT(uint64_t mod) : n(mod) {
+        // Newton iteration doubles the correct low bits each step (3 -> 96)
+        uint64_t x = mod;
+        for (int i = 0; i < 5; ++i) x *= 2 - mod * x;
+        inv = x;
+        one = (0 - mod) % mod;
+    }
+
+    // t / 2^64 mod n for t < n * 2^64
+    inline uint64_t reduce(uint128_t t) const {
+        uint64_t m = static_cast<uint64_t>(t) * inv;
+        uint64_t mn_hi = static_cast<uint64_t>((static_cast<uint128_t>(m) * n) >> 64);
+        uint64_t t_hi = static_cast<uint64_t>(t >> 64);
+        uint64_t r = t_hi - mn_hi;
+        return t_hi < mn_hi ? r + n : r;
+    }
+
+    inline uint64_t mul(uint64_t a, uint64_t b) const {
+        return reduce(static_cast<uint128_t>(a) * b);
+    }
+
+    inline uint64_t sqr(uint64_t a) const {
+        return reduce(static_cast<uint128_t>(a) * a);
+    }
+
+    inline uint64_t add(uint64_t a, uint64_t b) const {
+        uint64_t s = a + b;
+        return (s < a || s >= n) ? s - n : s;
+    }
+
+    inline uint64_t sub(uint64_t a, uint64_t b) const {
+        return a >= b ? a - b : a - b + n;
+    }
+
+    // multiply by 2: a shift plus a conditional subtract
+    inline uint64_t dbl(uint64_t a) const {
+        uint64_t d = a << 1;
+        return ((a >> 63) || d >= n) ? d - n : d;
+    }
+
+    inline uint64_t to_mont(uint64_t x) const {
+        return static_cast<uint64_t>((static_cast<uint128_t>(x % n) << 64) % n);
+    }
+
+    inline uint64_t from_mont(uint64_t x) const {
+        return reduce(x);
+    }
+};
+
+// two-limb modulus, CIOS Montgomery multiplication with a third carry word
+// so moduli right up to 2^128 work; the 64x64->128 products and carry
+// chains compile to mulx/adc
+template <> struct MontgomeryT<uint128_t> {
+    typedef uint128_t word;
+
+    uint128_t n;     // modulus, must be odd
+    uint64_t ninv;   // -n^-1 mod 2^64
+    uint128_t one;   // 2^128 mod n
+    mutable uint128_t r2 = 0; // 2^256 mod n, built on first to_mont
+
+    explicit MontgomeryT(uint128_t mod) : n(mod) {
+        uint64_t n0 = static_cast<uint64_t>(mod);
+        uint64_t x = n0;
+        for (int i = 0; i < 5; ++i) x *= 2 - n0 * x;
+        ninv = 0 - x;
+        one = (0 - mod) % mod;
+    }
+
+    inline uint128_t mul(uint128_t a, uint128_t b) const {
+        const uint64_t a0 = static_cast<uint64_t>(a), a1 = static_cast<uint64_t>(a >> 64);
+        const uint64_t n0 = static_cast<uint64_t>(n), n1 = static_cast<uint64_t>(n >> 64);
+        const uint64_t bw[2] = {static_cast<uint64_t>(b), static_cast<uint64_t>(b >> 64)};
+        uint64_t t0 = 0, t1 = 0, t2 = 0;
+        for (int i = 0; i < 2; ++i) {
+            // t += a * b[i]
+            uint128_t p = static_cast<uint128_t>(a0) * bw[i] + t0;
+            t0 = static_cast<uint64_t>(p);
+            p = static_cast<uint128_t>(a1) * bw[i] + t1 + static_cast<uint64_t>(p >> 64);
+            t1 = static_cast<uint64_t>(p);
+            p = static_cast<uint128_t>(t2) + static_cast<uint64_t>(p >> 64);
+            t2 = static_cast<uint64_t>(p);
+            uint64_t t3 = static_cast<uint64_t>(p >> 64);
+
+            // t = (t + q * n) / 2^64, q chosen so the low word cancels
+            uint64_t q = t0 * ninv;
+            p = static_cast<uint128_t>(q) * n0 + t0;
+            p = static_cast<uint128_t>(q) * n1 + t1 + static_cast<uint64_t>(p >> 64);
+            t0 = static_cast<uint64_t>(p);
+            p = static_cast<uint128_t>(t2) + static_cast<uint64_t>(p >> 64);
+            t1 = static_cast<uint64_t>(p);
+            t2 = t3 + static_cast<uint64_t>(p >> 64);
+        }
+        uint128_t r = (static_cast<uint128_t>(t1) << 64) | t0;
+        return (t2 || r >= n) ? r - n : r;
+    }
+
+    inline uint128_t sqr(uint128_t a) const { return mul(a, a); }
+
+    inline uint128_t add(uint128_t a, uint128_t b) const {
+        uint128_t s = a + b;
+        return (s < a || s >= n) ? s - n : s;
+    }
+
+    inline uint128_t sub(uint128_t a, uint128_t b) const {
+        return a >= b ? a - b : a - b + n;
+    }
+
+    inline uint128_t dbl(uint128_t a) const {
+        uint128_t d = a << 1;
+        return ((a >> 127) || d >= n) ? d - n : d;
+    }
+
+    inline uint128_t to_mont(uint128_t x) const {
+        if (r2 == 0) {
+            r2 = one;
+            for (int i = 0; i < 128; ++i) r2 = dbl(r2);
+        }
+        return mul(x % n, r2);
+    }
+
+    inline uint128_t from_mont(uint128_t x) const {
+        return mul(x, 1);
+    }
+};
+
+typedef MontgomeryT<uint64_t> Montgomery;
+typedef MontgomeryT<uint128_t> Montgomery128;
+
+// 2^power mod n in Montgomery form, left-to-right ladder where the
+// multiply step is just a doubling
+template <typename M>
+inline typename M::word pow2_mont(const M& m, typename M::word power){
+    typename M::word x = m.one;
+    if (power == 0) return x;
+    for (int i = top_bit(power); i >= 0; --i) {
+        x = m.sqr(x);
+        if ((power >> i) & 1) x = m.dbl(x);
+    }
+    return x;
+}
+
+// computes base^power % m.n using binary exponentiation
+// essentially Fermat primality test when base == 2 and power == n-1
+template <typename M>
+inline typename M::word bin_exp(const M& m, typename M::word base, typename M::word power){
+    if (base == 2) return m.from_mont(pow2_mont(m, power));
+
+    typename M::word result = m.one;
+    typename M::word b = m.to_mont(base);
+    while (power > 0){
+        if (power & 1) result = m.mul(result, b);
+        b = m.sqr(b);
+        power >>= 1;
+    }
+    return m.from_mont(result);
+}
+
+inline uint64_t bin_exp(uint64_t base, uint64_t power, uint64_t mod){
+    return bin_exp(Montgomery(mod), base, power);
+}
+
+// F(n) mod m.n using fast doubling
+template <typename M>
+inline typename M::word fast_fib(const M& m, typename M::word n){
+    typename M::word a = 0;      // F(k)
+    typename M::word b = m.one;  // F(k+1)
+
+    for (int i = top_bit(n | 1); i >= 0; --i) {
+        // F(2k) = F(k) * [2*F(k+1) − F(k)]
+        // F(2k+1) = F(k)^2 + F(k+1)^2
+        typename M::word t1 = m.mul(a, m.sub(m.dbl(b), a));
+        typename M::word t2 = m.add(m.sqr(a), m.sqr(b));
+
+        if ((n >> i) & 1) {
+            a = t2;              // F(n) = F(2k+1)
+            b = m.add(t1, t2);   // F(n+1) = F(2k) + F(2k+1)
+        } else {
+            a = t1;              // F(n) = F(2k)
+            b = t2;              // F(n+1) = F(2k+1)
+        }
+    }
+    return m.from_mont(a);
+}
+
+inline uint64_t fast_fib(uint64_t n, uint64_t p){
+    return fast_fib(Montgomery(p), n);
+}
+
+// Fibonacci condition through the Lucas V-sequence with P = 1, Q = -1
+// (V(k) are the Lucas numbers), costing one multiply and one squaring per bit
+//   V(2k)   = V(k)^2 - 2(-1)^k
+//   V(2k+1) = V(k)V(k+1) - (-1)^k
+//   5F(k)   = 2V(k+1) - V(k)
+//   F(2k)   = F(k)V(k)
+// with n = d * 2^s, d odd: 5F(n) = 5F(d) * V(d) * V(2d) * ... * V(d*2^(s-1))
+// returns 0 exactly when F(n) == 0 mod m.n, so it is a drop-in for the
+// fast_fib(n, p) == 0 check; the product exits early once it hits zero
+template <typename M>
+inline typename M::word lucas_fib(const M& m, typename M::word n){
+    typedef typename M::word T;
+    if (n == 0) return 0;
+    if (m.n % 5 == 0) return fast_fib(m, n); // 5F(n) would always vanish
+
+    int s = trailing_zeros(n);
+    T d = n >> s;
+    T two = m.dbl(m.one);
+
+    // ladder over the bits of d: v0 = V(k), v1 = V(k+1), starting at k = 1
+    T v0 = m.one;
+    T v1 = m.add(two, m.one);
+    bool odd = true; // parity of k
+    for (int i = top_bit(d) - 1; i >= 0; --i) {
+        T cross = odd ? m.add(m.mul(v0, v1), m.one) : m.sub(m.mul(v0, v1), m.one);
+        if ((d >> i) & 1) {
+            // k+1 has the opposite parity of k
+            v1 = odd ? m.sub(m.sqr(v1), two) : m.add(m.sqr(v1), two);
+            v0 = cross;
+            odd = true;
+        } else {
+            v0 = odd ? m.add(m.sqr(v0), two) : m.sub(m.sqr(v0), two);
+            v1 = cross;
+            odd = false;
+        }
+    }
+
+    // 5F(d), then fold in V(d * 2^i) for each factor of two in n
+    T acc = m.sub(m.dbl(v1), v0);
+    for (int i = 0; i < s && acc != 0; ++i) {
+        acc = m.mul(acc, v0);
+        if (i + 1 < s) v0 = (i == 0) ? m.add(m.sqr(v0), two) : m.sub(m.sqr(v0), two);
+    }
+    return m.from_mont(acc);
+}
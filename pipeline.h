@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "modarith.h"
+#include "primality.h"
+#include "kernels.h"
+#include "stats.h"
+
+// candidates flow through a chain of filter stages in batches of 256,
+// structure of arrays with one survivor bit per lane; a stage clears the
+// bits of the lanes it rejects and the batch is compacted before the next
+// one, so every kernel runs over a dense batch and stays hot in cache
+//
+// a lane is rejected when it cannot be a counterexample:
+//   sieve   the congruence sieve says it cannot pass both tests
+//   fermat  2^(n-1) != 1 mod n
+//   fib     F(n+1) != 0 mod n
+//   verify  n is prime (the strong tests of verify() prove it)
+// the filters commute, so any order finds the same counterexamples and
+// only the cost differs; whatever survives the whole chain is one
+
+namespace pipeline {
+
+const size_t width = 256;
+
+typedef stats::Stage Stage;
+
+template <typename T>
+struct Batch {
+    T n[width];
+    uint32_t tag[width];            // caller's id per lane, moves with it
+    uint64_t alive[width / 64];
+    size_t count = 0;
+
+    void push(T v, uint32_t t) {
+        n[count] = v;
+        tag[count] = t;
+        count++;
+    }
+
+    void keep_all() {
+        for (size_t w = 0; w < width / 64; ++w) {
+            size_t lanes = count > w * 64 ? count - w * 64 : 0;
+            alive[w] = lanes >= 64 ? ~0ULL : (1ULL << lanes) - 1;
+        }
+    }
+
+    bool is_alive(size_t i) const { return alive[i / 64] >> (i % 64) & 1; }
+    void reject(size_t i) { alive[i / 64] &= ~(1ULL << (i % 64)); }
+
+    // moves the survivors to the front in order, all of them alive again
+    void compact() {
+        size_t k = 0;
+        for (size_t w = 0; w < width / 64; ++w) {
+            for (uint64_t m = alive[w]; m; m &= m - 1) {
+                size_t i = w * 64 + __builtin_ctzll(m);
+                n[k] = n[i];
+                tag[k] = tag[i];
+                k++;
+            }
+        }
+        count = k;
+        keep_all();
+    }
+};
+
+// the sieve's verdict for the range the batch came from
+template <typename T>
+struct SieveMap {
+    const uint8_t* keep = nullptr;  // one entry per odd number from odd_lo
+    const uint8_t* not_prime = nullptr;  // with a catalogue, 0 where the prime map dropped a prime
+    T odd_lo = 0;
+};
+
+template <typename T>
+void run_stage(Stage s, Batch<T>& b, const SieveMap<T>& map){
+    switch (s) {
+    case stats::sieve_stage:
+        for (size_t i = 0; i < b.count; ++i) {
+            if (!map.keep[static_cast<size_t>((b.n[i] - map.odd_lo) / 2)]) b.reject(i);
+        }
+        break;
+    case stats::fermat_stage:
+        // a fresh batch is dense, so the Fermat masks are the survivor words
+        for (size_t i = 0; i < b.count; i += 64) {
+            size_t lanes = b.count - i < 64 ? b.count - i : 64;
+            b.alive[i / 64] = fermat2_batch(b.n + i, lanes);
+        }
+        break;
+    case stats::fib_stage:
+        for (size_t i = 0; i < b.count; i += 64) {
+            size_t lanes = b.count - i < 64 ? b.count - i : 64;
+            b.alive[i / 64] &= fib_batch(b.n + i, lanes);
+        }
+        break;
+    case stats::verify_stage:
+        for (size_t i = 0; i < b.count; i += 64) {
+            size_t lanes = b.count - i < 64 ? b.count - i : 64;
+            b.alive[i / 64] &= ~prime_batch(b.n + i, lanes);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+inline std::string describe(const std::vector<Stage>& chain){
+    std::string s;
+    for (Stage k : chain) s += (s.empty() ? "" : ",") + std::string(stats::stage_names[k]);
+    return s;
+}
+
+// "sieve,fermat,fib,verify" or any order of it; each stage at most once,
+// the sieve may be left out, false on anything else
+inline bool parse(const std::string& text, std::vector<Stage>& chain){
+    chain.clear();
+    std::stringstream in(text);
+    std::string name;
+    bool seen[stats::stage_count] = {};
+    while (std::getline(in, name, ',')) {
+        int k = 0;
+        while (k < stats::stage_count && name != stats::stage_names[k]) ++k;
+        if (k == stats::stage_count || seen[k]) return false;
+        seen[k] = true;
+        chain.push_back(static_cast<Stage>(k));
+    }
+    return seen[stats::fermat_stage] && seen[stats::fib_stage] && seen[stats::verify_stage];
+}
+
+inline size_t position(const std::vector<Stage>& chain, Stage s){
+    for (size_t i = 0; i < chain.size(); ++i) {
+        if (chain[i] == s) return i;
+    }
+    return chain.size();
+}
+
+} // namespace pipeline
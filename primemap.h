@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "primality.h"
+
+// prime map: a prime passes both PSW conditions and can never be a
+// counterexample, so the sieve stage drops the primes of a range too, and
+// whatever passes Fermat and Fibonacci after that is composite by
+// construction; in a range the map covers verify() never finds work
+//
+// the base primes below the bound are kept as half-gaps, one byte each
+// (the widest gap below 2^32 is 336), built by a segmented sieve in
+// L2-sized pieces; a worker range is marked in one pass over them, its
+// odd-only map (32 KB for the default 2^16-wide ranges) staying in cache
+//
+// the map is exact for a range when every prime up to sqrt(hi) is a base
+// prime; each range pays one step per base prime below sqrt(hi) and saves
+// the kernels on about width / ln(hi) primes, which stops paying around
+// 2^48, hence the default bound of 2^24
+
+class PrimeMap {
+private:
+    uint64_t limit;                 // every prime below it is in the table
+    std::vector<uint8_t> half_gap;  // odd base primes from 3, (p' - p) / 2 each
+
+public:
+    static const uint64_t default_bound = 1 << 24;
+
+    // base primes below bound, at most 2^32
+    explicit PrimeMap(uint64_t bound) : limit(bound < 3 ? 3 : bound) {
+        const uint64_t segment = 1 << 18;  // odd numbers per piece, 256 KB
+        std::vector<uint32_t> small;       // sieving primes for the pieces
+        uint64_t root = isqrt(limit) + 1;
+        std::vector<uint8_t> composite(root + 1, 0);
+        for (uint64_t p = 3; p <= root; p += 2) {
+            if (composite[p]) continue;
+            small.push_back(static_cast<uint32_t>(p));
+            for (uint64_t j = p * p; j <= root; j += 2 * p) composite[j] = 1;
+        }
+
+        std::vector<uint8_t> piece(segment);
+        uint64_t last = 3;
+        for (uint64_t lo = 3; lo < limit; lo += 2 * segment) {
+            size_t count = static_cast<size_t>(std::min<uint64_t>(segment, (limit - lo + 1) / 2));
+            mark(lo, count, small.data(), small.size(), piece.data());
+            for (size_t i = 0; i < count; ++i) {
+                if (piece[i]) continue;
+                uint64_t p = lo + 2 * i;
+                if (p > 3) half_gap.push_back(static_cast<uint8_t>((p - last) / 2));
+                last = p;
+            }
+        }
+    }
+
+    uint64_t bound() const { return limit; }
+    size_t primes() const { return half_gap.size() + 2; }  // with 2 and 3
+
+    // true when the table holds every prime up to sqrt(hi - 1)
+    template <typename T>
+    bool covers(T hi) const {
+        return static_cast<uint128_t>(limit) * limit >= static_cast<uint128_t>(hi);
+    }
+
+    // clears keep[i] where the odd number lo + 2i is prime; lo odd, the
+    // range must be covered; scratch is the caller's, reused across calls
+    void strip_primes(uint64_t lo, size_t count, uint8_t* keep, std::vector<uint8_t>& scratch) const {
+        if (count == 0) return;
+        scratch.resize(count);
+        uint8_t* composite = scratch.data();
+        memset(composite, 0, count);
+        uint64_t hi = lo + 2 * (count - 1);  // last odd number of the range
+        uint64_t p = 3;
+        for (size_t g = 0; ; ++g) {
+            if (p > hi / p) break;
+            strike(lo, count, p, composite);
+            if (g == half_gap.size()) break;
+            p += 2 * static_cast<uint64_t>(half_gap[g]);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (!composite[i] && lo + 2 * i > 1) keep[i] = 0;
+        }
+    }
+
+private:
+    // marks the odd multiples of p from p^2 on in the odd numbers lo + 2i
+    static void strike(uint64_t lo, size_t count, uint64_t p, uint8_t* composite) {
+        uint128_t first = static_cast<uint128_t>(p) * p;
+        if (first < lo) {
+            first = static_cast<uint128_t>((lo - 1) / p + 1) * p;
+            if (!(first & 1)) first += p;
+        }
+        if ((first - lo) / 2 >= count) return;
+        for (size_t i = static_cast<size_t>((first - lo) / 2); i < count; i += p) composite[i] = 1;
+    }
+
+    static void mark(uint64_t lo, size_t count, const uint32_t* small, size_t n, uint8_t* composite) {
+        memset(composite, 0, count);
+        uint64_t hi = lo + 2 * (count - 1);
+        for (size_t k = 0; k < n && static_cast<uint64_t>(small[k]) * small[k] <= hi; ++k) {
+            strike(lo, count, small[k], composite);
+        }
+    }
+};
@@ -0,0 +1,51 @@
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "psplist.h"
+
+// converts a text list of base-2 pseudoprimes (one per line, sorted, the
+// first number on each line is used so factored lists work too) into the
+// block-indexed binary format read by main --psp-file
+
+int main(int argc, char* argv[]){
+    if (argc < 3) {
+        std::cout << "usage: " << argv[0] << " input.txt output.psp [entries per block]" << std::endl;
+        return 1;
+    }
+    uint32_t block_size = argc > 3 ? std::stoul(argv[3]) : 4096;
+    if (block_size == 0) block_size = 4096;
+
+    std::ifstream in(argv[1]);
+    if (!in) {
+        std::cout << "could not open " << argv[1] << std::endl;
+        return 1;
+    }
+
+    psplist::Writer writer(block_size);
+    std::string line;
+    uint64_t line_no = 0, count = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        size_t pos = line.find_first_of("0123456789");
+        if (pos == std::string::npos || line[0] == '#') continue;
+        uint64_t v = std::strtoull(line.c_str() + pos, nullptr, 10);
+        if (!writer.add(v)) {
+            std::cout << "line " << line_no << ": " << v << " is not larger than the previous value" << std::endl;
+            return 1;
+        }
+        count++;
+    }
+
+    if (!writer.write(argv[2])) {
+        std::cout << "could not write " << argv[2] << std::endl;
+        return 1;
+    }
+    std::cout << count << " values written to " << argv[2] << std::endl;
+    return 0;
+}
+
+// LINUX COMPILE:
+// g++ psp_convert.cpp -o psp_convert -O3
@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "modarith.h"
+#include "primality.h"
+#include "sieve.h"
+#include "psplist.h"
+
+// constructive search for the base-2 pseudoprimes n < limit with n == ±2
+// mod 5, complete below the limit, instead of a Fermat test on every odd n
+//
+// if a prime p divides a 2-psp n then ord_p(2) | n-1, so writing n = m * r
+// with m the product of the smallest prime factors of n and L the lcm of
+// their orders, r == m^-1 (mod L) and r >= q, the largest prime of m
+// walking that progression costs about limit / (m * L) Fermat tests
+//
+// small m (below 64) would make that walk nearly as long as a plain scan,
+// so those prefixes are expanded instead:
+//   r prime:     ord_r(2) | m-1, so r divides 2^(m-1)-1 = (2^h-1)(2^h+1)
+//                with h = (m-1)/2 < 32, both factored by trial division
+//   r composite: its smallest prime q' <= sqrt(limit/m) extends the prefix
+// every other prefix (m >= 64, including a lone prime p > 64, the
+// large-prime part) is walked; the walks run on a thread pool, cut into
+// tasks by the last prime of the prefix, smaller primes first since they
+// carry the longest walks
+
+struct Prefix {
+    uint64_t m;     // product of the smallest primes, ascending
+    uint64_t q;     // largest prime in m, 2 for the empty prefix
+    uint64_t L;     // lcm of ord_p(2) over p | m
+};
+
+struct Task {
+    uint32_t prefix;      // index into the expanded prefixes
+    uint64_t q_lo, q_hi;  // walk m * q for the primes q in [q_lo, q_hi)
+};
+
+uint64_t limit = 1000000000000ULL;   // search n < limit
+uint64_t root;                       // every prime that can extend a prefix is <= root
+std::vector<bool> odd_composite;     // bit i for 2i+1, up to root
+std::vector<uint32_t> small_primes;  // up to 2^16, to factor p-1 for the orders
+
+std::vector<Prefix> expanded;
+std::vector<Task> tasks;
+std::atomic_uint64_t next_task, tasks_done, walked;
+
+bool is_prime_small(uint64_t q){
+    return q == 2 || (q & 1 && q <= root && !odd_composite[q / 2]);
+}
+
+void sieve_primes(){
+    root = isqrt(limit - 1) + 1;
+    odd_composite.assign(root / 2 + 1, false);
+    odd_composite[0] = true; // 1
+    for (uint64_t i = 3; i * i <= root; i += 2) {
+        if (odd_composite[i / 2]) continue;
+        for (uint64_t j = i * i; j <= root; j += 2 * i) odd_composite[j / 2] = true;
+    }
+    std::vector<bool> composite(1 << 16, false);
+    for (uint32_t p = 2; p < (1 << 16); ++p) {
+        if (composite[p]) continue;
+        small_primes.push_back(p);
+        for (uint32_t j = p * p; j < (1 << 16); j += p) composite[j] = true;
+    }
+}
+
+// ord_p(2) for an odd prime p < 2^32
+uint64_t order2(uint64_t p){
+    uint64_t ord = p - 1, rest = p - 1;
+    for (uint32_t f : small_primes) {
+        if (static_cast<uint64_t>(f) * f > rest) break;
+        if (rest % f) continue;
+        while (rest % f == 0) rest /= f;
+        while (ord % f == 0 && sieve_detail::pow_mod(2, ord / f, p) == 1) ord /= f;
+    }
+    if (rest > 1) {
+        while (ord % rest == 0 && sieve_detail::pow_mod(2, ord / rest, p) == 1) ord /= rest;
+    }
+    return ord;
+}
+
+// extends a prefix by prime q, false when no psp below the limit has it:
+// n == 1 (mod L) rules out any prime of m dividing L, and n > L
+bool extend(const Prefix& a, uint64_t q, Prefix& b){
+    uint64_t l = order2(q);
+    uint128_t L = static_cast<uint128_t>(a.L / sieve_detail::gcd(a.L, l)) * l;
+    if (L >= limit || static_cast<uint128_t>(a.m) * q >= limit) return false;
+    b = {a.m * q, q, static_cast<uint64_t>(L)};
+    return sieve_detail::gcd(b.m, b.L) == 1;
+}
+
+uint64_t inverse(uint64_t a, uint64_t mod){
+    int64_t old_r = static_cast<int64_t>(a % mod), r = static_cast<int64_t>(mod);
+    __int128 old_s = 1, s = 0;
+    while (r != 0) {
+        int64_t k = old_r / r;
+        int64_t t = old_r - k * r; old_r = r; r = t;
+        __int128 u = old_s - k * s; old_s = s; s = u;
+    }
+    return static_cast<uint64_t>((old_s % mod + mod) % mod);
+}
+
+bool plus_minus_2_mod_5(uint64_t n){
+    return n % 5 == 2 || n % 5 == 3;
+}
+
+bool fermat(uint64_t n){
+    return bin_exp(Montgomery(n), 2, n - 1) == 1;
+}
+
+// Fermat-tests n = p.m * r over r == m^-1 (mod L), lo <= r <= hi, keeping
+// only the odd n that are ±2 mod 5
+void walk(const Prefix& p, uint64_t lo, uint64_t hi, std::vector<uint64_t>& found){
+    if (lo > hi) return;
+    uint64_t a = p.L == 1 ? 0 : inverse(p.m % p.L, p.L);
+    uint128_t r = lo + (a + p.L - lo % p.L) % p.L;
+
+    // r mod 10 decides both conditions and steps by L mod 10
+    bool ok[10];
+    for (unsigned d = 0; d < 10; ++d) ok[d] = d & 1 && plus_minus_2_mod_5(p.m % 5 * d);
+    unsigned digit = static_cast<unsigned>(r % 10), step = p.L % 10;
+    uint64_t tested = 0;
+    for (; r <= hi; r += p.L) {
+        if (ok[digit]) {
+            uint64_t n = p.m * static_cast<uint64_t>(r);
+            tested++;
+            if (fermat(n)) found.push_back(n);
+        }
+        digit = (digit + step) % 10;
+    }
+    walked += tested;
+}
+
+void trial_factor(uint64_t x, std::vector<uint64_t>& out){
+    for (uint64_t d = 3; d * d <= x; d += 2) {
+        if (x % d) continue;
+        out.push_back(d);
+        while (x % d == 0) x /= d;
+    }
+    if (x > 1) out.push_back(x);
+}
+
+// depth-first over the prefixes below 64; records them with the psps of
+// the form m * r, r prime, and queues the walks of their extensions
+void expand(const Prefix& p, std::vector<uint64_t>& found){
+    uint32_t id = static_cast<uint32_t>(expanded.size());
+    expanded.push_back(p);
+    if (p.m > 1) {
+        std::vector<uint64_t> primes;
+        uint64_t h = (p.m - 1) / 2;
+        trial_factor((1ULL << h) - 1, primes);
+        trial_factor((1ULL << h) + 1, primes);
+        for (uint64_t s : primes) {
+            if (s < p.q || s > (limit - 1) / p.m) continue;
+            uint64_t n = p.m * s;
+            if (n & 1 && plus_minus_2_mod_5(n) && fermat(n)) found.push_back(n);
+        }
+    }
+
+    // extensions by q with q^2 <= limit / m, at least one more prime follows
+    uint64_t q_max = isqrt((limit - 1) / p.m);
+    uint64_t q = p.q + 1;
+    for (; q <= q_max && p.m * q < 64; ++q) {
+        Prefix c;
+        if (q != 5 && is_prime_small(q) && extend(p, q, c)) expand(c, found);
+    }
+    // walks, one prime per task while they are long, then wider ranges
+    while (q <= q_max) {
+        uint64_t width = std::max<uint64_t>(1, q / 64);
+        uint64_t q_hi = std::min(q_max + 1, q + width);
+        tasks.push_back({id, q, q_hi});
+        q = q_hi;
+    }
+}
+
+void worker(std::vector<uint64_t>& found){
+    for (uint64_t t; (t = next_task++) < tasks.size(); tasks_done++) {
+        const Task& task = tasks[t];
+        const Prefix& p = expanded[task.prefix];
+        for (uint64_t q = task.q_lo; q < task.q_hi; ++q) {
+            Prefix c;
+            if (q == 5 || !is_prime_small(q) || !extend(p, q, c)) continue;
+            walk(c, q, (limit - 1) / c.m, found);
+        }
+    }
+}
+
+int main(int argc, char* argv[]){
+    std::string out_path = "psp.bin";
+    unsigned threads = std::thread::hardware_concurrency();
+    bool ok = true;
+    for (int a = 1; a < argc && ok; ++a) {
+        std::string arg = argv[a];
+        if (arg == "--limit" && a + 1 < argc) {
+            uint128_t v = 0;
+            ok = parse_u128(argv[++a], v) && v >= 2 && v <= UINT64_MAX;
+            limit = static_cast<uint64_t>(v);
+        }
+        else if (arg == "--out" && a + 1 < argc) out_path = argv[++a];
+        else if (arg == "--threads" && a + 1 < argc) threads = std::stoul(argv[++a]);
+        else ok = false;
+    }
+    if (!ok) {
+        std::cout << "usage: " << argv[0] << " [--limit N] [--out FILE] [--threads N]" << std::endl;
+        return 1;
+    }
+    if (threads == 0) threads = 1;
+
+    auto t0 = std::chrono::steady_clock::now();
+    sieve_primes();
+    std::vector<std::vector<uint64_t>> found(threads + 1);
+    expand({1, 2, 1}, found[threads]);
+    std::cout << "Searching n < " << limit << ": " << expanded.size() << " expanded prefixes, "
+              << tasks.size() << " walk tasks on " << threads << " threads" << std::endl;
+
+    std::vector<std::thread> pool;
+    for (unsigned i = 0; i < threads; ++i) pool.emplace_back(worker, std::ref(found[i]));
+    while (tasks_done < tasks.size()) {
+        for (int i = 0; i < 100 && tasks_done < tasks.size(); ++i) usleep(100000);
+        std::cout << tasks_done << " / " << tasks.size() << " tasks, " << walked << " Fermat tests" << std::endl;
+    }
+    for (auto& t : pool) t.join();
+
+    std::vector<uint64_t> psps;
+    for (const auto& f : found) psps.insert(psps.end(), f.begin(), f.end());
+    std::sort(psps.begin(), psps.end());
+    psps.erase(std::unique(psps.begin(), psps.end()), psps.end());
+
+    // the Fibonacci condition on every psp, a pass is the counterexample
+    uint64_t failures = 0;
+    psplist::Writer writer;
+    for (uint64_t n : psps) {
+        writer.add(n);
+        if (lucas_fib(Montgomery(n), n + 1) == 0) {
+            std::cout << n << " is a base-2 pseudoprime with F(n+1) == 0 mod n, counterexample found!" << std::endl;
+            failures++;
+        }
+    }
+    if (!writer.write(out_path)) {
+        std::cout << "could not write " << out_path << std::endl;
+        return 1;
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << psps.size() << " base-2 pseudoprimes == ±2 mod 5 below " << limit << " written to " << out_path
+              << " (" << walked << " Fermat tests, " << secs << " s)" << std::endl;
+    return failures ? 2 : 0;
+}
+
+// LINUX COMPILE:
+// g++ psp_search.cpp -o psp_search -O3 -march=native -pthread
+
+// the list feeds the Fibonacci check of main directly:
+// ./psp_search --limit 1000000000000 --out psp.bin
+// ./main --psp-file psp.bin
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// compact binary list of sorted 64-bit values (base-2 pseudoprimes)
+//
+//   header  magic "PSWPSP02", total count, block count, entries per block
+//   index   per block: first value, payload offset, entry count, crc32 of
+//           the first value, the count and the payload
+//   payload per block: deltas to the previous value as LEB128 varints
+//
+// the index makes range selection a binary search and lets threads decode
+// blocks independently, the crc catches a damaged block before it is used
+// and decoding never reads past the block, whatever its index entry says
+// (lists from before the crc covered the index, PSWPSP01, are refused)
+
+namespace psplist {
+
+const char magic[8] = {'P', 'S', 'W', 'P', 'S', 'P', '0', '2'};
+
+struct Header {
+    char magic[8];
+    uint64_t count;
+    uint64_t blocks;
+    uint32_t block_size;
+    uint32_t reserved;
+};
+
+struct BlockIndex {
+    uint64_t first;
+    uint64_t offset;  // from the start of the payload
+    uint32_t count;
+    uint32_t crc;     // block_crc() of first, count and the payload
+};
+
+struct Crc32Table {
+    uint32_t t[256];
+    Crc32Table() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+    }
+};
+
+// crc continues a previous result over more data
+inline uint32_t crc32(const uint8_t* data, size_t len, uint32_t crc = 0){
+    static const Crc32Table table;
+    uint32_t c = crc ^ 0xffffffffu;
+    for (size_t i = 0; i < len; ++i) c = table.t[(c ^ data[i]) & 0xff] ^ (c >> 8);
+    return c ^ 0xffffffffu;
+}
+
+inline uint32_t block_crc(uint64_t first, uint32_t count, const uint8_t* payload, size_t len){
+    uint8_t fields[12];
+    memcpy(fields, &first, 8);
+    memcpy(fields + 8, &count, 4);
+    return crc32(payload, len, crc32(fields, sizeof(fields)));
+}
+
+inline void put_varint(std::vector<uint8_t>& out, uint64_t v){
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v) | 0x80);
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+// the varint at p into v, false when it runs past end or 64 bits
+inline bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& v){
+    v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t b = *p++;
+        v |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+// builds a list from values appended in increasing order
+class Writer {
+private:
+    uint32_t block_size;
+    std::vector<BlockIndex> index;
+    std::vector<uint8_t> payload;
+    uint64_t count = 0, last = 0;
+    size_t block_start = 0;
+
+    void close_block() {
+        if (index.empty() || index.back().count == 0) return;
+        BlockIndex& ix = index.back();
+        ix.crc = block_crc(ix.first, ix.count, payload.data() + block_start, payload.size() - block_start);
+    }
+
+public:
+    explicit Writer(uint32_t block_size = 4096) : block_size(block_size) {}
+
+    // false when v is not larger than the previous value
+    bool add(uint64_t v) {
+        if (count > 0 && v <= last) return false;
+        if (index.empty() || index.back().count == block_size) {
+            close_block();
+            block_start = payload.size();
+            index.push_back({v, payload.size(), 0, 0});
+        } else {
+            put_varint(payload, v - last);
+        }
+        index.back().count++;
+        last = v;
+        count++;
+        return true;
+    }
+
+    bool write(const std::string& path) {
+        close_block();
+        Header h;
+        memcpy(h.magic, magic, sizeof(h.magic));
+        h.count = count;
+        h.blocks = index.size();
+        h.block_size = block_size;
+        h.reserved = 0;
+
+        FILE* f = fopen(path.c_str(), "wb");
+        if (!f) return false;
+        bool ok = fwrite(&h, sizeof(h), 1, f) == 1
+               && fwrite(index.data(), sizeof(BlockIndex), index.size(), f) == index.size()
+               && fwrite(payload.data(), 1, payload.size(), f) == payload.size();
+        return fclose(f) == 0 && ok;
+    }
+};
+
+// read-only view of a list through mmap
+class Reader {
+private:
+    const uint8_t* base = nullptr;
+    size_t length = 0;
+    const Header* header = nullptr;
+    const BlockIndex* index = nullptr;
+    const uint8_t* payload = nullptr;
+
+public:
+    Reader() {}
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+    ~Reader() { if (base) munmap(const_cast<uint8_t*>(base), length); }
+
+    bool open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+            close(fd);
+            return false;
+        }
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) return false;
+        base = static_cast<const uint8_t*>(p);
+        length = st.st_size;
+        madvise(p, length, MADV_SEQUENTIAL);
+
+        header = reinterpret_cast<const Header*>(base);
+        if (header->blocks > (length - sizeof(Header)) / sizeof(BlockIndex)) return false;
+        size_t index_end = sizeof(Header) + header->blocks * sizeof(BlockIndex);
+        if (memcmp(header->magic, magic, sizeof(magic)) != 0 || index_end > length) return false;
+        index = reinterpret_cast<const BlockIndex*>(base + sizeof(Header));
+        payload = base + index_end;
+        for (uint64_t b = 0; b < header->blocks; ++b) {
+            if (index[b].offset > length - index_end) return false;
+        }
+        return true;
+    }
+
+    uint64_t count() const { return header->count; }
+    uint64_t blocks() const { return header->blocks; }
+    uint64_t first(uint64_t b) const { return index[b].first; }
+
+    // first block that can hold values >= v
+    uint64_t block_for(uint64_t v) const {
+        uint64_t lo = 0, hi = header->blocks;
+        while (lo < hi) {
+            uint64_t mid = (lo + hi) / 2;
+            if (index[mid].first <= v) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo > 0 ? lo - 1 : 0;
+    }
+
+    // decodes block b into out, false when there is no such block or its
+    // checksum does not match
+    bool decode(uint64_t b, std::vector<uint64_t>& out) const {
+        if (b >= header->blocks) return false;
+        const BlockIndex& ix = index[b];
+        if (ix.count == 0) return false;
+        size_t end = b + 1 < header->blocks ? index[b + 1].offset : length - (payload - base);
+        // every delta takes a byte at least
+        if (end < ix.offset || ix.count - 1 > end - ix.offset) return false;
+        if (block_crc(ix.first, ix.count, payload + ix.offset, end - ix.offset) != ix.crc) return false;
+
+        out.resize(ix.count);
+        const uint8_t* p = payload + ix.offset;
+        const uint8_t* stop = payload + end;
+        uint64_t v = ix.first;
+        out[0] = v;
+        for (uint32_t i = 1; i < ix.count; ++i) {
+            uint64_t d;
+            if (!get_varint(p, stop, d)) return false;
+            v += d;
+            out[i] = v;
+        }
+        return p == stop;
+    }
+};
+
+} // namespace psplist
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <sched.h>
+
+#include "psw.h"
+#include "modarith.h"
+#include "primality.h"
+#include "kernels.h"
+
+// libpsw: the kernels of the search behind a C ABI
+// the Fermat kernel (scalar, AVX2, AVX-512 or IFMA) is picked by cpuid on
+// first use, see kernels.h, so a library built without -march still runs
+// the vector kernels where the CPU has them
+
+namespace {
+
+std::atomic<unsigned> thread_setting(0);
+
+// below this many numbers per thread a batch is not worth splitting
+const size_t min_per_thread = 1 << 15;
+
+unsigned thread_count(){
+    unsigned t = thread_setting.load();
+    if (t > 0) return t;
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0 && CPU_COUNT(&mask) > 0) return CPU_COUNT(&mask);
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// calls f(lo, hi) over [0, count) in contiguous slices, one per thread
+template <typename F>
+void split(size_t count, F f){
+    size_t parts = std::min<size_t>(thread_count(), count / min_per_thread);
+    if (parts <= 1) {
+        f(0, count);
+        return;
+    }
+    std::vector<std::thread> pool;
+    for (size_t p = 0; p < parts; ++p) {
+        pool.emplace_back(f, count * p / parts, count * (p + 1) / parts);
+    }
+    for (auto& t : pool) t.join();
+}
+
+bool testable(uint64_t n){
+    return n >= 3 && (n & 1);
+}
+
+// the batch kernels want odd n > 1, so the others are left out of their
+// groups and get 0
+template <typename Kernel>
+void batch_slice(Kernel kernel, const uint64_t* n, size_t count, uint8_t* out){
+    uint64_t group[64];
+    size_t where[64];
+    size_t k = 0;
+    auto flush = [&] {
+        uint64_t pass = kernel(group, k);
+        for (size_t j = 0; j < k; ++j) out[where[j]] = (pass >> j) & 1;
+        k = 0;
+    };
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = 0;
+        if (!testable(n[i])) continue;
+        group[k] = n[i];
+        where[k++] = i;
+        if (k == 64) flush();
+    }
+    if (k > 0) flush();
+}
+
+void fermat_slice(const uint64_t* n, size_t count, uint8_t* out){
+    batch_slice([](const uint64_t* c, size_t k) { return fermat2_batch(c, k); }, n, count, out);
+}
+
+bool fib_passes(uint64_t n){
+    return testable(n) && lucas_fib(Montgomery(n), n + 1) == 0;
+}
+
+} // namespace
+
+extern "C" {
+
+int psw_version(void){
+    return PSW_VERSION;
+}
+
+void psw_set_threads(unsigned threads){
+    thread_setting = threads;
+}
+
+void psw_fermat2_batch(const uint64_t* n, size_t count, uint8_t* out){
+    split(count, [=](size_t lo, size_t hi) { fermat_slice(n + lo, hi - lo, out + lo); });
+}
+
+void psw_fib_batch(const uint64_t* n, size_t count, uint8_t* out){
+    split(count, [=](size_t lo, size_t hi) {
+        batch_slice([](const uint64_t* c, size_t k) { return fib_batch(c, k); }, n + lo, hi - lo, out + lo);
+    });
+}
+
+void psw_is_prime_batch(const uint64_t* n, size_t count, uint8_t* out){
+    split(count, [=](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i) out[i] = verify(n[i]).prime;
+    });
+}
+
+size_t psw_check_batch(const uint64_t* n, size_t count, uint8_t* out){
+    std::atomic<size_t> found(0);
+    split(count, [&](size_t lo, size_t hi) {
+        fermat_slice(n + lo, hi - lo, out + lo);
+        size_t hits = 0;
+        for (size_t i = lo; i < hi; ++i) {
+            if (!out[i] || !fib_passes(n[i])) continue;
+            out[i] |= PSW_FIB;
+            if (verify(n[i]).prime) out[i] |= PSW_PRIME;
+            else if (n[i] % 5 == 2 || n[i] % 5 == 3) {
+                out[i] |= PSW_COUNTEREXAMPLE;
+                hits++;
+            }
+        }
+        found += hits;
+    });
+    return found;
+}
+
+} // extern "C"
+
+// LINUX COMPILE (static and shared library):
+// g++ -c psw.cpp -o psw.o -O3 -fPIC -pthread && ar rcs libpsw.a psw.o
+// g++ -shared psw.cpp -o libpsw.so -O3 -fPIC -pthread
+
+// using it:
+// gcc tool.c -o tool -L. -lpsw -lstdc++ -pthread
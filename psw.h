@@ -0,0 +1,50 @@
+#ifndef PSW_H
+#define PSW_H
+
+/* libpsw: batch entry points for the tests of the PSW search, usable from
+ * C and C++ (see psw.cpp for building libpsw.a / libpsw.so)
+ *
+ * every call takes count numbers and writes one byte per number to out;
+ * batches above a few tens of thousands of numbers are split over threads,
+ * so one large call is much cheaper than many small ones
+ * the functions are safe to call from several threads at once */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PSW_VERSION 1
+
+/* flags written by psw_check_batch */
+#define PSW_FERMAT 1          /* 2^(n-1) == 1 mod n */
+#define PSW_FIB 2             /* F(n+1) == 0 mod n, tested only after PSW_FERMAT */
+#define PSW_PRIME 4           /* n is prime, tested only after both */
+#define PSW_COUNTEREXAMPLE 8  /* n == ±2 mod 5 passed both tests and is composite */
+
+/* PSW_VERSION of the library actually linked */
+int psw_version(void);
+
+/* threads for large batches, 0 (the default) for every CPU the process may use */
+void psw_set_threads(unsigned threads);
+
+/* out[i] = 1 when 2^(n[i]-1) == 1 mod n[i]; 0 for even n and n < 3 */
+void psw_fermat2_batch(const uint64_t* n, size_t count, uint8_t* out);
+
+/* out[i] = 1 when F(n[i]+1) == 0 mod n[i]; 0 for even n and n < 3 */
+void psw_fib_batch(const uint64_t* n, size_t count, uint8_t* out);
+
+/* out[i] = 1 when n[i] is prime, deterministic for every 64-bit value */
+void psw_is_prime_batch(const uint64_t* n, size_t count, uint8_t* out);
+
+/* out[i] = PSW_* flags of n[i], each test only run when the previous one
+ * passed; returns the number of counterexamples in the batch */
+size_t psw_check_batch(const uint64_t* n, size_t count, uint8_t* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
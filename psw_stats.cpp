@@ -0,0 +1,29 @@
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "stats.h"
+
+// prints the live stats of a running main process from its shared memory
+// segment (/dev/shm/psw-stats-<pid>), never touching the process itself
+
+int main(int argc, char* argv[]){
+    if (argc < 2) {
+        std::cout << "usage: " << argv[0] << " pid [--prom]" << std::endl;
+        return 1;
+    }
+    uint64_t pid = std::stoull(argv[1]);
+    bool prom = argc > 2 && std::string(argv[2]) == "--prom";
+
+    stats::Reader reader;
+    if (!reader.open(pid)) {
+        std::cout << "no stats segment for process " << pid << std::endl;
+        return 1;
+    }
+    stats::Snapshot snap = reader.snapshot();
+    std::cout << (prom ? stats::to_prometheus(snap) : stats::to_json(snap));
+    return 0;
+}
+
+// LINUX COMPILE:
+// g++ psw_stats.cpp -o psw_stats -O3
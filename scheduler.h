@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// chunked range scheduler: the candidate space [start, end) is cut into
+// fixed-width blocks handed out from an atomic counter, each worker owns a
+// deque of ranges it works through chunk by chunk, and an idle worker
+// steals the upper half of another worker's last range
+// completion is tracked per block so the lowest contiguous completed block
+// (the frontier) can be reported without any central producer
+// workers can be grouped (one group per NUMA node): each group then draws
+// blocks from its own partition, stripes of consecutive blocks dealt out
+// round robin between the groups, and steals from its own group first;
+// a group whose partition runs dry or runs too far ahead takes from the
+// others, so the frontier still advances evenly
+// T is the candidate type (uint64_t or uint128_t); block indices and
+// per-block counts stay 64-bit either way
+
+template <typename T>
+struct BasicRange {
+    uint64_t block;   // block this range was cut from
+    T lo, hi;         // numbers in [lo, hi)
+};
+
+template <typename T>
+class BasicRangeScheduler {
+public:
+    typedef BasicRange<T> Range;
+
+private:
+    struct alignas(64) WorkerDeque {
+        std::mutex mutex;
+        std::deque<Range> ranges;
+    };
+
+    struct alignas(64) Cursor {
+        std::atomic<uint64_t> taken{0}; // blocks of this group's partition handed out
+    };
+
+    static const uint64_t ring_size = 1 << 12; // blocks tracked past the frontier
+
+    T start, end;
+    uint64_t width, chunk;
+    uint64_t block_count;
+    std::vector<std::unique_ptr<WorkerDeque>> deques;
+    std::vector<unsigned> group_of;        // worker -> group
+    unsigned groups = 1;
+    uint64_t stripe = 1;                   // consecutive blocks per partition turn
+    std::unique_ptr<Cursor[]> cursors;
+    alignas(64) std::atomic<uint64_t> handed_out; // one past the highest block handed out
+    alignas(64) std::atomic<uint64_t> frontier_block;
+    std::unique_ptr<std::atomic<uint64_t>[]> remaining; // numbers left per ring slot
+    std::unique_ptr<std::atomic<uint64_t>[]> finished;  // block + 1 once complete
+    uint64_t resume_base = 0;
+    std::vector<bool> resume_done; // block resume_base + i already finished
+
+    T block_lo(uint64_t b) const { return start + static_cast<T>(b) * width; }
+    T block_hi(uint64_t b) const { return b + 1 == block_count ? end : start + static_cast<T>(b + 1) * width; }
+
+    // takes up to one chunk from the front of the worker's own deque
+    bool take_own(unsigned id, Range& out) {
+        WorkerDeque& d = *deques[id];
+        std::lock_guard<std::mutex> lock(d.mutex);
+        if (d.ranges.empty()) return false;
+        Range& front = d.ranges.front();
+        out = front;
+        if (front.hi - front.lo > chunk) {
+            out.hi = front.lo + chunk;
+            front.lo = out.hi;
+        } else {
+            d.ranges.pop_front();
+        }
+        return true;
+    }
+
+    void finish_block(uint64_t b) {
+        finished[b % ring_size] = b + 1;
+        uint64_t f = frontier_block.load();
+        while (f < block_count && finished[f % ring_size].load() == f + 1) {
+            if (frontier_block.compare_exchange_weak(f, f + 1)) ++f;
+        }
+    }
+
+    // i-th block of group g's partition
+    uint64_t partition_block(unsigned g, uint64_t i) const {
+        return ((i / stripe) * groups + g) * stripe + i % stripe;
+    }
+
+    // blocks of group g's partition below block b
+    uint64_t partition_count(unsigned g, uint64_t b) const {
+        uint64_t span = stripe * groups, rem = b % span, skip = g * stripe;
+        return b / span * stripe + (rem > skip ? std::min(rem - skip, stripe) : 0);
+    }
+
+    bool partition_empty(unsigned g) const {
+        return partition_block(g, cursors[g].taken.load()) >= block_count;
+    }
+
+    // next block of group g, false when it is used up or too far ahead
+    bool take_from(unsigned g, uint64_t& b) {
+        std::atomic<uint64_t>& taken = cursors[g].taken;
+        uint64_t i = taken.load();
+        while (true) {
+            b = partition_block(g, i);
+            if (b >= block_count) return false;
+            if (b >= frontier_block.load() + ring_size) return false; // too far ahead of the frontier
+            if (!taken.compare_exchange_weak(i, i + 1)) continue;
+            uint64_t h = handed_out.load();
+            while (h < b + 1 && !handed_out.compare_exchange_weak(h, b + 1)) {}
+            if (b - resume_base < resume_done.size() && resume_done[b - resume_base]) {
+                // finished before the restart
+                remaining[b % ring_size] = 0;
+                finish_block(b);
+                i = taken.load();
+                continue;
+            }
+            return true;
+        }
+    }
+
+    bool take_block(unsigned id) {
+        uint64_t b = 0;
+        bool found = false;
+        for (unsigned k = 0; k < groups && !found; ++k) found = take_from((group_of[id] + k) % groups, b);
+        if (!found) return false;
+
+        remaining[b % ring_size] = static_cast<uint64_t>(block_hi(b) - block_lo(b));
+        WorkerDeque& d = *deques[id];
+        std::lock_guard<std::mutex> lock(d.mutex);
+        d.ranges.push_back({b, block_lo(b), block_hi(b)});
+        return true;
+    }
+
+    // moves the upper half of another worker's last range into our deque,
+    // trying workers of our own group first
+    bool steal(unsigned id) {
+        for (size_t k = 1; k < 2 * deques.size(); ++k) {
+            size_t v = (id + k) % deques.size();
+            if ((group_of[v] == group_of[id]) != (k < deques.size())) continue;
+            WorkerDeque& victim = *deques[v];
+            Range stolen;
+            {
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (victim.ranges.empty()) continue;
+                Range& back = victim.ranges.back();
+                if (victim.ranges.size() > 1 || back.hi - back.lo <= chunk) {
+                    stolen = back;
+                    victim.ranges.pop_back();
+                } else {
+                    T mid = back.lo + (back.hi - back.lo) / 2;
+                    stolen = {back.block, mid, back.hi};
+                    back.hi = mid;
+                }
+            }
+            WorkerDeque& d = *deques[id];
+            std::lock_guard<std::mutex> lock(d.mutex);
+            d.ranges.push_back(stolen);
+            return true;
+        }
+        return false;
+    }
+
+public:
+    // a 128-bit range is cut short after 2^64 - 1 blocks
+    BasicRangeScheduler(T start, T end, unsigned workers,
+                        uint64_t width = 1 << 16, uint64_t chunk = 1 << 14)
+        : start(start), end(end), width(width), chunk(chunk),
+          handed_out(0), frontier_block(0),
+          remaining(new std::atomic<uint64_t>[ring_size]),
+          finished(new std::atomic<uint64_t>[ring_size]) {
+        T blocks = end > start ? (end - start - 1) / width + 1 : 0;
+        if (blocks > UINT64_MAX) {
+            blocks = UINT64_MAX;
+            this->end = start + static_cast<T>(blocks) * width;
+        }
+        block_count = static_cast<uint64_t>(blocks);
+        for (unsigned i = 0; i < workers; ++i) deques.emplace_back(new WorkerDeque());
+        group_of.assign(workers, 0);
+        cursors.reset(new Cursor[1]);
+        for (uint64_t i = 0; i < ring_size; ++i) {
+            remaining[i] = 0;
+            finished[i] = 0;
+        }
+    }
+
+    // splits the blocks between groups of workers, group[i] being the
+    // group of worker i; must be called before restore and before any
+    // worker starts
+    void partition(const std::vector<unsigned>& group) {
+        groups = 1;
+        for (size_t i = 0; i < group_of.size(); ++i) {
+            group_of[i] = i < group.size() ? group[i] : 0;
+            groups = std::max(groups, group_of[i] + 1);
+        }
+        // every group has to fit a few stripes inside the frontier window
+        stripe = std::max<uint64_t>(1, std::min<uint64_t>(64, ring_size / (4 * groups)));
+        cursors.reset(new Cursor[groups]);
+    }
+
+    // next range for worker id, false once every block is handed out and
+    // nothing is left to steal
+    bool next(unsigned id, Range& out) {
+        while (true) {
+            if (take_own(id, out)) return true;
+            if (take_block(id) || steal(id)) continue;
+            bool all_taken = true;
+            for (unsigned g = 0; g < groups && all_taken; ++g) all_taken = partition_empty(g);
+            if (all_taken) return false;
+            std::this_thread::yield(); // waiting on the frontier to catch up
+        }
+    }
+
+    // marks [r.lo, r.hi) as tested and advances the frontier if possible
+    void complete(const Range& r) {
+        uint64_t slot = r.block % ring_size;
+        uint64_t len = static_cast<uint64_t>(r.hi - r.lo);
+        if (remaining[slot].fetch_sub(len) != len) return;
+        finish_block(r.block);
+    }
+
+    // frontier block plus a bitmap of the blocks finished past it,
+    // bit i of done is block frontier + i
+    void snapshot(uint64_t& frontier, std::vector<uint8_t>& done) const {
+        frontier = frontier_block.load();
+        uint64_t last = handed_out.load();
+        done.assign(last > frontier ? (last - frontier + 7) / 8 : 0, 0);
+        for (uint64_t b = frontier; b < last; ++b) {
+            if (finished[b % ring_size].load() == b + 1) done[(b - frontier) / 8] |= 1 << ((b - frontier) % 8);
+        }
+    }
+
+    // continue from a snapshot, must be called before any worker starts
+    void restore(uint64_t frontier, const std::vector<uint8_t>& done) {
+        frontier_block = frontier;
+        handed_out = frontier;
+        for (unsigned g = 0; g < groups; ++g) cursors[g].taken = partition_count(g, frontier);
+        resume_base = frontier;
+        resume_done.assign(done.size() * 8, false);
+        for (size_t i = 0; i < resume_done.size(); ++i) resume_done[i] = (done[i / 8] >> (i % 8)) & 1;
+    }
+
+    T range_start() const { return start; }
+    T range_end() const { return end; }
+    uint64_t block_width() const { return width; }
+
+    // number of contiguous blocks completed from the start
+    uint64_t completed_blocks() const { return frontier_block.load(); }
+
+    // every number below this has been tested
+    T frontier() const {
+        uint64_t f = frontier_block.load();
+        return f >= block_count ? end : block_lo(f);
+    }
+};
+
+typedef BasicRange<uint64_t> Range;
+typedef BasicRangeScheduler<uint64_t> RangeScheduler;
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// congruence sieve: if a small prime q divides n and n passes both PSW
+// conditions, then ord_q(2) | n-1 (Fermat) and z(q) | n+1 (Fibonacci),
+// z(q) being the rank of apparition of q in the Fibonacci sequence
+// so the odd multiples of q that can pass form one arithmetic progression
+// (or none when the congruences conflict), everything else is dropped
+// before any modpow; with fermat_only the progression is ord_q(2) | n-1
+// alone, and nothing that passes the Fermat test is dropped
+
+namespace sieve_detail {
+
+inline uint64_t gcd(uint64_t a, uint64_t b){
+    while (b) { uint64_t t = a % b; a = b; b = t; }
+    return a;
+}
+
+// moduli below 2^32, so products fit in 64 bits
+inline uint64_t pow_mod(uint64_t b, uint64_t e, uint64_t m){
+    uint64_t r = 1 % m;
+    b %= m;
+    while (e) {
+        if (e & 1) r = r * b % m;
+        b = b * b % m;
+        e >>= 1;
+    }
+    return r;
+}
+
+inline uint64_t fib_mod(uint64_t n, uint64_t m){
+    uint64_t a = 0, b = 1 % m;
+    for (int i = 63 - __builtin_clzll(n | 1); i >= 0; --i) {
+        uint64_t t1 = a * ((2 * b + m - a) % m) % m;
+        uint64_t t2 = (a * a % m + b * b % m) % m;
+        if ((n >> i) & 1) { a = t2; b = (t1 + t2) % m; }
+        else { a = t1; b = t2; }
+    }
+    return a;
+}
+
+inline std::vector<uint64_t> prime_factors(uint64_t n){
+    std::vector<uint64_t> f;
+    for (uint64_t d = 2; d * d <= n; ++d) {
+        if (n % d == 0) {
+            f.push_back(d);
+            while (n % d == 0) n /= d;
+        }
+    }
+    if (n > 1) f.push_back(n);
+    return f;
+}
+
+// multiplicative order of 2 mod q, q an odd prime
+inline uint64_t order2(uint64_t q){
+    uint64_t ord = q - 1;
+    for (uint64_t f : prime_factors(q - 1)) {
+        while (ord % f == 0 && pow_mod(2, ord / f, q) == 1) ord /= f;
+    }
+    return ord;
+}
+
+// smallest k > 0 with q | F(k)
+inline uint64_t fib_rank(uint64_t q){
+    if (q == 2) return 3;
+    if (q == 5) return 5;
+    uint64_t m = (q % 5 == 1 || q % 5 == 4) ? q - 1 : q + 1;
+    for (uint64_t f : prime_factors(m)) {
+        while (m % f == 0 && fib_mod(m / f, q) == 0) m /= f;
+    }
+    return m;
+}
+
+// lcm(a, b), 0 when it does not fit in 64 bits
+inline uint64_t lcm_fits(uint64_t a, uint64_t b){
+    unsigned __int128 l = static_cast<unsigned __int128>(a / gcd(a, b)) * b;
+    return l >> 64 ? 0 : static_cast<uint64_t>(l);
+}
+
+// x == r1 mod m1 and x == r2 mod m2, false when inconsistent; the lcm
+// must fit in 64 bits
+inline bool crt(uint64_t& r1, uint64_t& m1, uint64_t r2, uint64_t m2){
+    uint64_t g = gcd(m1, m2);
+    uint64_t diff = (r2 % m2 + m2 - r1 % m2) % m2;
+    if (diff % g != 0) return false;
+    uint64_t m2g = m2 / g;
+    // solve m1 * t == diff (mod m2), t = (diff/g) * (m1/g)^-1 mod m2/g
+    uint64_t t = 0;
+    if (m2g > 1) {
+        int64_t old_r = static_cast<int64_t>((m1 / g) % m2g), r = static_cast<int64_t>(m2g);
+        int64_t old_s = 1, s = 0;
+        while (r != 0) {
+            int64_t q = old_r / r;
+            int64_t tmp = old_r - q * r; old_r = r; r = tmp;
+            tmp = old_s - q * s; old_s = s; s = tmp;
+        }
+        uint64_t inv = static_cast<uint64_t>((old_s % static_cast<int64_t>(m2g) + static_cast<int64_t>(m2g)) % static_cast<int64_t>(m2g));
+        t = static_cast<uint64_t>(static_cast<unsigned __int128>((diff / g) % m2g) * inv % m2g);
+    }
+    uint64_t lcm = m1 * m2g;
+    r1 = static_cast<uint64_t>((r1 + static_cast<unsigned __int128>(m1) * t) % lcm);
+    m1 = lcm;
+    return true;
+}
+
+} // namespace sieve_detail
+
+class CongruenceSieve {
+private:
+    struct Entry {
+        uint32_t q;
+        uint64_t stride;  // allowed odd multiples repeat every stride-th, 0 if none
+        uint64_t t0;      // n = q(2t+1) is allowed when t == t0 mod stride
+    };
+    std::vector<Entry> entries;
+
+public:
+    // tables for the odd primes q < bound, bound 0 disables the sieve; the
+    // modulus lcm(2q, ord_q(2), z(q)) grows like q^3 and passes 2^64 for
+    // some q above 2^21, those are left out
+    explicit CongruenceSieve(uint32_t bound, bool fermat_only = false) {
+        using namespace sieve_detail;
+        std::vector<bool> composite(bound, false);
+        for (uint64_t q = 3; q < bound; q += 2) {
+            if (composite[q]) continue;
+            for (uint64_t k = q * q; k < bound; k += 2 * q) composite[k] = true;
+
+            uint64_t ord = order2(q), z = fermat_only ? 1 : fib_rank(q);
+            uint64_t l = lcm_fits(2 * q, ord);
+            if (l == 0 || lcm_fits(l, z) == 0) continue;
+
+            uint64_t r = 0, m = q;  // n == 0 mod q
+            Entry e = {static_cast<uint32_t>(q), 0, 0};
+            if (crt(r, m, 1, 2) && crt(r, m, 1, ord) && crt(r, m, z - 1, z)) {
+                e.stride = m / (2 * q);
+                e.t0 = (r / q - 1) / 2;
+            }
+            entries.push_back(e);
+        }
+    }
+
+    size_t size() const { return entries.size(); }
+
+    // keep[i] is cleared for the odd number lo + 2i when a sieving prime
+    // proves it cannot pass both conditions; lo must be odd
+    // T is uint64_t or uint128_t, only the start offset needs the wide type
+    template <typename T>
+    void sieve(T lo, size_t count, uint8_t* keep) const {
+        const T max = ~static_cast<T>(0);
+        for (size_t i = 0; i < count; ++i) keep[i] = 1;
+        for (const Entry& e : entries) {
+            T q = e.q;
+            if (lo / q >= max / q - 1) continue; // q * k would overflow
+            T k = lo / q + (lo % q != 0);
+            if (!(k & 1)) ++k;
+            if (k == 1) k = 3; // q itself is prime
+            T offset = (q * k - lo) / 2;
+            if (offset >= count) continue;
+            size_t idx = static_cast<size_t>(offset);
+            if (e.stride == 0) {
+                for (; idx < count; idx += e.q) keep[idx] = 0;
+                continue;
+            }
+            T t = (k - 1) / 2;
+            uint64_t j = static_cast<uint64_t>((t % e.stride + e.stride - e.t0 % e.stride) % e.stride);
+            for (; idx < count; idx += e.q) {
+                if (j != 0) keep[idx] = 0;
+                if (++j == e.stride) j = 0;
+            }
+        }
+    }
+};
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <immintrin.h>
+
+#include "modarith.h"
+
+// batched base-2 Fermat test: 4 (AVX2) or 8 (AVX-512) candidates run the
+// Montgomery ladder in lockstep, one candidate per 64-bit lane
+// neither ISA has a 64x64->128 multiply, so products are assembled from
+// 32x32->64 partial products; the per-lane constants come from Montgomery
+// lanes whose exponent is shorter simply square 1 until their top bit
+// with IFMA and every lane below 2^52 the products are 52-bit madds instead
+//
+// every kernel carries its own target attribute and is compiled whatever
+// -march says; kernels.h picks the ones the running CPU has
+
+#define PSW_TARGET_AVX2 __attribute__((target("avx2,bmi2")))
+#define PSW_TARGET_AVX512 __attribute__((target("avx512f,avx512dq,avx2,bmi2")))
+#define PSW_TARGET_IFMA __attribute__((target("avx512f,avx512dq,avx512ifma,avx2,bmi2")))
+
+// high and low 64 bits of a * b per lane
+PSW_TARGET_AVX512 static inline void mul_wide8(__m512i a, __m512i b, __m512i& hi, __m512i& lo){
+    const __m512i lo32 = _mm512_set1_epi64(0xffffffffULL);
+    __m512i a1 = _mm512_srli_epi64(a, 32);
+    __m512i b1 = _mm512_srli_epi64(b, 32);
+    __m512i p00 = _mm512_mul_epu32(a, b);
+    __m512i p01 = _mm512_mul_epu32(a, b1);
+    __m512i p10 = _mm512_mul_epu32(a1, b);
+    __m512i p11 = _mm512_mul_epu32(a1, b1);
+    __m512i mid = _mm512_add_epi64(_mm512_srli_epi64(p00, 32),
+                  _mm512_add_epi64(_mm512_and_si512(p01, lo32), _mm512_and_si512(p10, lo32)));
+    lo = _mm512_or_si512(_mm512_and_si512(p00, lo32), _mm512_slli_epi64(mid, 32));
+    hi = _mm512_add_epi64(_mm512_add_epi64(p11, _mm512_srli_epi64(mid, 32)),
+         _mm512_add_epi64(_mm512_srli_epi64(p01, 32), _mm512_srli_epi64(p10, 32)));
+}
+
+// low 64 bits of a * b per lane
+PSW_TARGET_AVX512 static inline __m512i mul_lo8(__m512i a, __m512i b){
+    __m512i cross = _mm512_add_epi64(_mm512_mul_epu32(_mm512_srli_epi64(a, 32), b),
+                                     _mm512_mul_epu32(a, _mm512_srli_epi64(b, 32)));
+    return _mm512_add_epi64(_mm512_mul_epu32(a, b), _mm512_slli_epi64(cross, 32));
+}
+
+// a * b / 2^64 mod n per lane, same REDC as Montgomery::reduce
+PSW_TARGET_AVX512 static inline __m512i mont_mul8(__m512i a, __m512i b, __m512i n, __m512i inv){
+    __m512i t_hi, t_lo, mn_hi, mn_lo;
+    mul_wide8(a, b, t_hi, t_lo);
+    __m512i m = mul_lo8(t_lo, inv);
+    mul_wide8(m, n, mn_hi, mn_lo);
+    __m512i r = _mm512_sub_epi64(t_hi, mn_hi);
+    __mmask8 under = _mm512_cmplt_epu64_mask(t_hi, mn_hi);
+    return _mm512_mask_add_epi64(r, under, r, n);
+}
+
+// lane i of the result is set when 2^(n[i]-1) == 1 mod n[i]
+PSW_TARGET_AVX512 static inline unsigned fermat2_batch8(const uint64_t* cand){
+    alignas(64) uint64_t inv[8], one[8];
+    for (int j = 0; j < 8; ++j) {
+        Montgomery m(cand[j]);
+        inv[j] = m.inv;
+        one[j] = m.one;
+    }
+    __m512i n = _mm512_loadu_si512(cand);
+    __m512i e = _mm512_sub_epi64(n, _mm512_set1_epi64(1));
+    __m512i vinv = _mm512_load_si512(inv);
+    __m512i vone = _mm512_load_si512(one);
+
+    uint64_t all = 0;
+    for (int j = 0; j < 8; ++j) all |= cand[j] - 1;
+
+    __m512i x = vone;
+    for (int i = 63 - __builtin_clzll(all); i >= 0; --i) {
+        x = mont_mul8(x, x, n, vinv);
+        __mmask8 bit = _mm512_test_epi64_mask(e, _mm512_set1_epi64(1ULL << i));
+        // doubling: shift, subtract n when the top bit fell out or d >= n
+        __m512i d = _mm512_slli_epi64(x, 1);
+        __mmask8 wrap = _mm512_movepi64_mask(x) | _mm512_cmpge_epu64_mask(d, n);
+        d = _mm512_mask_sub_epi64(d, wrap, d, n);
+        x = _mm512_mask_mov_epi64(x, bit, d);
+    }
+    return _mm512_cmpeq_epu64_mask(x, vone);
+}
+
+PSW_TARGET_AVX2 static inline void mul_wide4(__m256i a, __m256i b, __m256i& hi, __m256i& lo){
+    const __m256i lo32 = _mm256_set1_epi64x(0xffffffffLL);
+    __m256i a1 = _mm256_srli_epi64(a, 32);
+    __m256i b1 = _mm256_srli_epi64(b, 32);
+    __m256i p00 = _mm256_mul_epu32(a, b);
+    __m256i p01 = _mm256_mul_epu32(a, b1);
+    __m256i p10 = _mm256_mul_epu32(a1, b);
+    __m256i p11 = _mm256_mul_epu32(a1, b1);
+    __m256i mid = _mm256_add_epi64(_mm256_srli_epi64(p00, 32),
+                  _mm256_add_epi64(_mm256_and_si256(p01, lo32), _mm256_and_si256(p10, lo32)));
+    lo = _mm256_or_si256(_mm256_and_si256(p00, lo32), _mm256_slli_epi64(mid, 32));
+    hi = _mm256_add_epi64(_mm256_add_epi64(p11, _mm256_srli_epi64(mid, 32)),
+         _mm256_add_epi64(_mm256_srli_epi64(p01, 32), _mm256_srli_epi64(p10, 32)));
+}
+
+PSW_TARGET_AVX2 static inline __m256i mul_lo4(__m256i a, __m256i b){
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                     _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(_mm256_mul_epu32(a, b), _mm256_slli_epi64(cross, 32));
+}
+
+// AVX2 only has signed 64-bit compares, flip the sign bits first
+PSW_TARGET_AVX2 static inline __m256i cmpgt_epu64(__m256i a, __m256i b){
+    const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+    return _mm256_cmpgt_epi64(_mm256_xor_si256(a, sign), _mm256_xor_si256(b, sign));
+}
+
+PSW_TARGET_AVX2 static inline __m256i mont_mul4(__m256i a, __m256i b, __m256i n, __m256i inv){
+    __m256i t_hi, t_lo, mn_hi, mn_lo;
+    mul_wide4(a, b, t_hi, t_lo);
+    __m256i m = mul_lo4(t_lo, inv);
+    mul_wide4(m, n, mn_hi, mn_lo);
+    __m256i r = _mm256_sub_epi64(t_hi, mn_hi);
+    __m256i under = cmpgt_epu64(mn_hi, t_hi);
+    return _mm256_add_epi64(r, _mm256_and_si256(under, n));
+}
+
+PSW_TARGET_AVX2 static inline unsigned fermat2_batch4(const uint64_t* cand){
+    alignas(32) uint64_t inv[4], one[4];
+    for (int j = 0; j < 4; ++j) {
+        Montgomery m(cand[j]);
+        inv[j] = m.inv;
+        one[j] = m.one;
+    }
+    __m256i n = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cand));
+    __m256i e = _mm256_sub_epi64(n, _mm256_set1_epi64x(1));
+    __m256i vinv = _mm256_load_si256(reinterpret_cast<const __m256i*>(inv));
+    __m256i vone = _mm256_load_si256(reinterpret_cast<const __m256i*>(one));
+    const __m256i zero = _mm256_setzero_si256();
+
+    uint64_t all = 0;
+    for (int j = 0; j < 4; ++j) all |= cand[j] - 1;
+
+    __m256i x = vone;
+    for (int i = 63 - __builtin_clzll(all); i >= 0; --i) {
+        x = mont_mul4(x, x, n, vinv);
+        __m256i bit = _mm256_cmpgt_epi64(_mm256_and_si256(_mm256_srli_epi64(e, i), _mm256_set1_epi64x(1)), zero);
+        __m256i d = _mm256_slli_epi64(x, 1);
+        __m256i wrap = _mm256_or_si256(_mm256_cmpgt_epi64(zero, x), _mm256_xor_si256(cmpgt_epu64(n, d), _mm256_set1_epi64x(-1)));
+        d = _mm256_sub_epi64(d, _mm256_and_si256(wrap, n));
+        x = _mm256_blendv_epi8(x, d, bit);
+    }
+    return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(x, vone)));
+}
+
+// a * b / 2^52 mod n per lane for n < 2^52, Montgomery with R = 2^52:
+// m = lo(ab) * -n^-1 mod 2^52 makes lo(ab) + lo(mn) a multiple of 2^52,
+// so the result is hi(ab) + hi(mn) plus that carry, below 2n
+PSW_TARGET_IFMA static inline __m512i mont_mul8_52(__m512i a, __m512i b, __m512i n, __m512i ninv){
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i lo = _mm512_madd52lo_epu64(zero, a, b);
+    __m512i hi = _mm512_madd52hi_epu64(zero, a, b);
+    __m512i m = _mm512_madd52lo_epu64(zero, lo, ninv);
+    __m512i carry = _mm512_srli_epi64(_mm512_madd52lo_epu64(lo, m, n), 52);
+    __m512i r = _mm512_madd52hi_epu64(_mm512_add_epi64(hi, carry), m, n);
+    return _mm512_mask_sub_epi64(r, _mm512_cmpge_epu64_mask(r, n), r, n);
+}
+
+// fermat2_batch8 for eight candidates below 2^52
+PSW_TARGET_IFMA static inline unsigned fermat2_batch8_52(const uint64_t* cand){
+    const uint64_t mask52 = (1ULL << 52) - 1;
+    alignas(64) uint64_t ninv[8], one[8];
+    for (int j = 0; j < 8; ++j) {
+        ninv[j] = (0 - Montgomery(cand[j]).inv) & mask52;
+        one[j] = (1ULL << 52) % cand[j];
+    }
+    __m512i n = _mm512_loadu_si512(cand);
+    __m512i e = _mm512_sub_epi64(n, _mm512_set1_epi64(1));
+    __m512i vninv = _mm512_load_si512(ninv);
+    __m512i vone = _mm512_load_si512(one);
+
+    uint64_t all = 0;
+    for (int j = 0; j < 8; ++j) all |= cand[j] - 1;
+
+    __m512i x = vone;
+    for (int i = 63 - __builtin_clzll(all); i >= 0; --i) {
+        x = mont_mul8_52(x, x, n, vninv);
+        __mmask8 bit = _mm512_test_epi64_mask(e, _mm512_set1_epi64(1ULL << i));
+        // x < n < 2^52, so the doubling cannot leave the lane
+        __m512i d = _mm512_slli_epi64(x, 1);
+        d = _mm512_mask_sub_epi64(d, _mm512_cmpge_epu64_mask(d, n), d, n);
+        x = _mm512_mask_mov_epi64(x, bit, d);
+    }
+    return _mm512_cmpeq_epu64_mask(x, vone);
+}
+
+// the scalar ladder over count odd candidates, bit i set when cand[i] passes
+template <typename T>
+inline uint64_t fermat2_scalar(const T* cand, size_t count){
+    uint64_t mask = 0;
+    for (size_t i = 0; i < count; ++i) {
+        MontgomeryT<T> m(cand[i]);
+        if (pow2_mont(m, cand[i] - 1) == m.one) mask |= 1ULL << i;
+    }
+    return mask;
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "modarith.h"
+
+// per-thread run statistics in a POSIX shared memory segment
+// every worker owns one cache-line-aligned block and is its only writer,
+// so a counter update is a plain load and store with no lock prefix and no
+// line shared between threads; readers (the printer, the exporters, or
+// another process attached through psw_stats) sum the blocks whenever they
+// like and never slow the workers down
+// counters are monotonic; a reader may see one block a little behind the
+// others, which only matters for display
+
+namespace stats {
+
+const char magic[8] = {'P', 'S', 'W', 'S', 'T', 'A', 'T', '2'};
+const unsigned max_workers = 1024;
+
+// the filter stages of a worker, indexes of stage_in/stage_pass
+enum Stage { sieve_stage, fermat_stage, fib_stage, verify_stage, stage_count };
+const char* const stage_names[stage_count] = {"sieve", "fermat", "fib", "verify"};
+
+struct alignas(64) WorkerStats {
+    std::atomic<uint64_t> tested;         // candidates that reached the Fermat test
+    std::atomic<uint64_t> sieved;         // candidates dropped by the sieve
+    std::atomic<uint64_t> fermat_passes;
+    std::atomic<uint64_t> fib_passes;
+    std::atomic<uint64_t> verify_calls;
+    std::atomic<uint64_t> ns_sieve, ns_fermat, ns_fib, ns_verify;
+    std::atomic<uint64_t> last_lo, last_hi; // last candidate range end, two words
+    std::atomic<uint64_t> stage_in[stage_count], stage_pass[stage_count];
+};
+
+struct Segment {
+    char magic[8];
+    uint32_t workers;         // blocks in use
+    uint32_t reserved;
+    uint64_t pid;
+    uint64_t start_ns;        // steady clock at creation, for rates
+    WorkerStats worker[max_workers];
+};
+
+// owner-only increment, no read-modify-write instruction needed
+inline void bump(std::atomic<uint64_t>& c, uint64_t n){
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+inline void set_last(WorkerStats& w, uint128_t v){
+    w.last_hi.store(static_cast<uint64_t>(v >> 64), std::memory_order_relaxed);
+    w.last_lo.store(static_cast<uint64_t>(v), std::memory_order_relaxed);
+}
+
+// counter of the time a worker spent in stage s
+inline std::atomic<uint64_t>& stage_time(WorkerStats& w, Stage s){
+    std::atomic<uint64_t>* ns[stage_count] = {&w.ns_sieve, &w.ns_fermat, &w.ns_fib, &w.ns_verify};
+    return *ns[s];
+}
+
+inline uint64_t now_ns(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline std::string segment_name(uint64_t pid){
+    return "/psw-stats-" + std::to_string(pid);
+}
+
+// sums of all blocks at one moment
+struct Snapshot {
+    uint64_t workers = 0;
+    uint64_t tested = 0, sieved = 0, fermat_passes = 0, fib_passes = 0, verify_calls = 0;
+    uint64_t ns_sieve = 0, ns_fermat = 0, ns_fib = 0, ns_verify = 0;
+    uint64_t stage_in[stage_count] = {}, stage_pass[stage_count] = {};
+    uint128_t last = 0;       // highest last candidate over the workers
+    double elapsed = 0;       // seconds since the segment was created
+};
+
+inline Snapshot aggregate(const Segment& s){
+    Snapshot snap;
+    snap.workers = s.workers;
+    for (uint32_t i = 0; i < s.workers && i < max_workers; ++i) {
+        const WorkerStats& w = s.worker[i];
+        snap.tested += w.tested.load(std::memory_order_relaxed);
+        snap.sieved += w.sieved.load(std::memory_order_relaxed);
+        snap.fermat_passes += w.fermat_passes.load(std::memory_order_relaxed);
+        snap.fib_passes += w.fib_passes.load(std::memory_order_relaxed);
+        snap.verify_calls += w.verify_calls.load(std::memory_order_relaxed);
+        snap.ns_sieve += w.ns_sieve.load(std::memory_order_relaxed);
+        snap.ns_fermat += w.ns_fermat.load(std::memory_order_relaxed);
+        snap.ns_fib += w.ns_fib.load(std::memory_order_relaxed);
+        snap.ns_verify += w.ns_verify.load(std::memory_order_relaxed);
+        for (int k = 0; k < stage_count; ++k) {
+            snap.stage_in[k] += w.stage_in[k].load(std::memory_order_relaxed);
+            snap.stage_pass[k] += w.stage_pass[k].load(std::memory_order_relaxed);
+        }
+        uint128_t last = static_cast<uint128_t>(w.last_hi.load(std::memory_order_relaxed)) << 64
+                       | w.last_lo.load(std::memory_order_relaxed);
+        if (last > snap.last) snap.last = last;
+    }
+    snap.elapsed = (now_ns() - s.start_ns) / 1e9;
+    return snap;
+}
+
+inline uint64_t stage_ns(const Snapshot& s, int k){
+    const uint64_t ns[stage_count] = {s.ns_sieve, s.ns_fermat, s.ns_fib, s.ns_verify};
+    return ns[k];
+}
+
+inline std::string to_json(const Snapshot& s){
+    char buf[2048];
+    int len = snprintf(buf, sizeof(buf),
+             "{\"workers\": %lu, \"elapsed_s\": %.3f, \"tested\": %lu, \"sieved\": %lu, "
+             "\"fermat_passes\": %lu, \"fib_passes\": %lu, \"verify_calls\": %lu, "
+             "\"seconds\": {\"sieve\": %.3f, \"fermat\": %.3f, \"fib\": %.3f, \"verify\": %.3f}, "
+             "\"stages\": {",
+             s.workers, s.elapsed, s.tested, s.sieved, s.fermat_passes, s.fib_passes, s.verify_calls,
+             s.ns_sieve / 1e9, s.ns_fermat / 1e9, s.ns_fib / 1e9, s.ns_verify / 1e9);
+    for (int k = 0; k < stage_count; ++k) {
+        len += snprintf(buf + len, sizeof(buf) - len, "%s\"%s\": {\"in\": %lu, \"pass\": %lu}",
+                        k ? ", " : "", stage_names[k], s.stage_in[k], s.stage_pass[k]);
+    }
+    snprintf(buf + len, sizeof(buf) - len, "}, \"last_candidate\": \"%s\"}\n", to_string(s.last).c_str());
+    return buf;
+}
+
+inline std::string to_prometheus(const Snapshot& s){
+    std::string out;
+    auto metric = [&](const char* name, const char* type, const std::string& value) {
+        out += std::string("# TYPE ") + name + " " + type + "\n" + name + " " + value + "\n";
+    };
+    metric("psw_workers", "gauge", std::to_string(s.workers));
+    metric("psw_candidates_tested_total", "counter", std::to_string(s.tested));
+    metric("psw_candidates_sieved_total", "counter", std::to_string(s.sieved));
+    metric("psw_fermat_passes_total", "counter", std::to_string(s.fermat_passes));
+    metric("psw_fib_passes_total", "counter", std::to_string(s.fib_passes));
+    metric("psw_verify_calls_total", "counter", std::to_string(s.verify_calls));
+    out += "# TYPE psw_stage_seconds_total counter\n";
+    out += "psw_stage_seconds_total{stage=\"sieve\"} " + std::to_string(s.ns_sieve / 1e9) + "\n";
+    out += "psw_stage_seconds_total{stage=\"fermat\"} " + std::to_string(s.ns_fermat / 1e9) + "\n";
+    out += "psw_stage_seconds_total{stage=\"fib\"} " + std::to_string(s.ns_fib / 1e9) + "\n";
+    out += "psw_stage_seconds_total{stage=\"verify\"} " + std::to_string(s.ns_verify / 1e9) + "\n";
+    out += "# TYPE psw_stage_candidates_total counter\n";
+    for (int k = 0; k < stage_count; ++k) {
+        out += std::string("psw_stage_candidates_total{stage=\"") + stage_names[k] + "\",result=\"in\"} " + std::to_string(s.stage_in[k]) + "\n";
+        out += std::string("psw_stage_candidates_total{stage=\"") + stage_names[k] + "\",result=\"pass\"} " + std::to_string(s.stage_pass[k]) + "\n";
+    }
+    // a double loses the low digits past 2^53, good enough for a gauge
+    metric("psw_last_candidate", "gauge", to_string(s.last));
+    return out;
+}
+
+// replaces path atomically so a scraper never reads half a file
+inline bool write_file(const std::string& path, const std::string& text){
+    std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "w");
+    if (!f) return false;
+    bool ok = fwrite(text.data(), 1, text.size(), f) == text.size();
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// the segment of this process, falls back to private memory when shm is
+// not available so the run itself never depends on it
+class Publisher {
+private:
+    Segment* seg = nullptr;
+    std::string name;
+    bool shared = false;
+
+public:
+    explicit Publisher(unsigned workers) {
+        name = segment_name(getpid());
+        int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+        if (fd >= 0 && ftruncate(fd, sizeof(Segment)) == 0) {
+            void* p = mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (p != MAP_FAILED) {
+                seg = static_cast<Segment*>(p);
+                shared = true;
+            }
+        }
+        if (fd >= 0) close(fd);
+        if (!shared) {
+            if (fd >= 0) shm_unlink(name.c_str());
+            void* p = mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            seg = static_cast<Segment*>(p);
+        }
+        // fresh pages are zero, which is a valid state for every counter
+        seg->workers = workers < max_workers ? workers : max_workers;
+        seg->pid = getpid();
+        seg->start_ns = now_ns();
+        memcpy(seg->magic, magic, sizeof(magic));
+    }
+
+    Publisher(const Publisher&) = delete;
+    Publisher& operator=(const Publisher&) = delete;
+
+    ~Publisher() {
+        munmap(seg, sizeof(Segment));
+        if (shared) shm_unlink(name.c_str());
+    }
+
+    bool is_shared() const { return shared; }
+    const std::string& segment() const { return name; }
+    unsigned workers() const { return seg->workers; }
+
+    // id must be below workers(), each block has a single writer
+    WorkerStats& worker(unsigned id) { return seg->worker[id]; }
+
+    Snapshot snapshot() const { return aggregate(*seg); }
+};
+
+// read-only view of another process's segment
+class Reader {
+private:
+    const Segment* seg = nullptr;
+
+public:
+    Reader() {}
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+    ~Reader() { if (seg) munmap(const_cast<Segment*>(seg), sizeof(Segment)); }
+
+    bool open(uint64_t pid) {
+        int fd = shm_open(segment_name(pid).c_str(), O_RDONLY, 0);
+        if (fd < 0) return false;
+        void* p = mmap(nullptr, sizeof(Segment), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) return false;
+        seg = static_cast<const Segment*>(p);
+        return memcmp(seg->magic, magic, sizeof(magic)) == 0;
+    }
+
+    Snapshot snapshot() const { return aggregate(*seg); }
+};
+
+} // namespace stats
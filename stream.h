@@ -0,0 +1,403 @@
+#pragma once
+
+#include <charconv>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "modarith.h"
+#include "pipeline.h"
+#include "stats.h"
+
+// streaming mode: numbers from a list instead of a range, every one gets
+// the PSW conditions and, when it passes both, verify(); one result line
+// per number in input order
+//
+//   text    decimal numbers below 2^128 separated by whitespace, '#'
+//           starts a comment running to the end of the line
+//   binary  native-endian uint64 records
+//
+// a regular file is mapped and cut into chunks in place, anything else
+// (stdin, a pipe) is read into chunk buffers; workers take chunks in
+// order, and each finished chunk's output waits in the reorder buffer
+// until every earlier one has been written, with at most `window` chunks
+// outstanding so memory stays bounded however far ahead a worker gets
+
+namespace stream {
+
+const size_t chunk_bytes = 1 << 20;
+
+enum Outcome : uint8_t {
+    untested,
+    invalid,            // not a number, or below 2
+    composite_fermat,   // 2^(n-1) != 1 mod n
+    composite_fib,      // F(n - (n/5)) != 0 mod n
+    prime,
+    pseudoprime,        // passed both, composite, == ±1 mod 5
+    counterexample,     // passed both, composite, == ±2 mod 5
+};
+const char* const outcome_names[] = {"untested", "invalid", "composite-fermat", "composite-fib",
+                                     "prime", "pseudoprime", "counterexample"};
+
+struct Chunk {
+    uint64_t seq = 0;
+    const char* data = nullptr;
+    size_t length = 0;
+    bool comment = false;       // starts inside a comment, only after a megabyte without a break
+    std::vector<char> buffer;   // read input lands here, mapped input is used in place
+};
+
+// the separators of text input; every other byte belongs to a token
+inline bool is_space(char ch){
+    return ch == ' ' || ch == '\n' || ch == '\t' || ch == '\r' || ch == '\f' || ch == '\v';
+}
+
+class Source {
+private:
+    int fd = -1;
+    bool binary = false;
+    const char* map = nullptr;
+    size_t map_length = 0;
+    size_t pos = 0;             // next unissued byte of the mapping
+    std::vector<char> carry;    // start of a token or record cut off by the last read
+    bool carry_comment = false; // the last read ended inside a comment
+    bool eof = false;
+    bool error = false;
+    uint64_t seq = 0;
+    std::mutex lock;
+
+public:
+    Source() {}
+    Source(const Source&) = delete;
+    Source& operator=(const Source&) = delete;
+    ~Source() {
+        if (map) munmap(const_cast<char*>(map), map_length);
+        if (fd > 0) close(fd);
+    }
+
+    // "-" for stdin
+    bool open(const std::string& path, bool records) {
+        binary = records;
+        fd = path == "-" ? 0 : ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) return false;
+        if (S_ISREG(st.st_mode) && st.st_size > 0) {
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (p != MAP_FAILED) {
+                map = static_cast<const char*>(p);
+                map_length = st.st_size;
+                madvise(p, map_length, MADV_SEQUENTIAL);
+            }
+        }
+        return true;
+    }
+
+    // the next chunk in input order, false at the end of the input
+    bool next(Chunk& c) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (map ? !next_mapped(c) : !next_read(c)) return false;
+        c.seq = seq++;
+        return true;
+    }
+
+    bool failed() const { return error; }
+
+    // bytes at the end of a binary input that do not make a whole record
+    size_t trailing() const { return binary ? carry.size() + (map ? map_length % 8 : 0) : 0; }
+
+private:
+    // end of the chunk starting at p that ends near p + want: at the
+    // first text break from want on, on a record boundary in binary
+    size_t cut(const char* p, size_t avail, size_t want) const {
+        if (want >= avail) return binary ? avail - avail % 8 : avail;
+        if (binary) return want - want % 8;
+        bool comment = false;
+        size_t e = text_break(p, avail, want, comment);
+        return e >= want ? e : avail;
+    }
+
+    // the first break in p[0, avail) at or past want, else the last one,
+    // 0 when there is none; a break follows whitespace outside a comment,
+    // so a comment never runs on into the next chunk; comment is the state
+    // at p going in and at avail coming out
+    static size_t text_break(const char* p, size_t avail, size_t want, bool& comment) {
+        size_t last = 0;
+        bool token = false;
+        for (size_t i = 0; i < avail; ++i) {
+            char ch = p[i];
+            if (comment && ch != '\n') continue;
+            comment = false;
+            if (is_space(ch)) {
+                token = false;
+                last = i + 1;
+                if (last >= want) break;
+            }
+            else if (!token && ch == '#') comment = true;
+            else token = true;
+        }
+        return last;
+    }
+
+    bool next_mapped(Chunk& c) {
+        size_t end = pos + cut(map + pos, map_length - pos, chunk_bytes);
+        if (end == pos) return false;
+        c.data = map + pos;
+        c.length = end - pos;
+        pos = end;
+        return true;
+    }
+
+    bool next_read(Chunk& c) {
+        c.buffer.swap(carry);
+        carry.clear();
+        c.comment = carry_comment;
+        size_t have = c.buffer.size();
+        while (!eof && have < chunk_bytes) {
+            c.buffer.resize(chunk_bytes);
+            ssize_t r = read(fd, c.buffer.data() + have, chunk_bytes - have);
+            if (r > 0) have += r;
+            else {
+                error = r < 0;
+                eof = true;
+            }
+        }
+        c.buffer.resize(have);
+
+        // up to the last whole token or record, the rest waits for the next read
+        size_t end = have;
+        bool comment = c.comment;
+        if (binary) end -= have % 8;
+        else if (!eof) {
+            end = text_break(c.buffer.data(), have, have, comment);
+            // a megabyte without a break is no number anyway, but a comment
+            // that long goes on in the next chunk
+            if (end == 0) end = have;
+            else comment = false;
+        }
+        carry_comment = comment;
+        carry.assign(c.buffer.begin() + end, c.buffer.end());
+        c.buffer.resize(end);
+        c.data = c.buffer.data();
+        c.length = end;
+        return end > 0;
+    }
+};
+
+// writes chunk outputs to fd in sequence order; whichever worker hands in
+// the next chunk due writes it and any that were waiting behind it
+class Reorder {
+private:
+    int fd;
+    uint64_t window;
+    uint64_t next = 0;          // first chunk not written yet
+    bool writing = false;
+    bool error = false;
+    std::map<uint64_t, std::string> ready;
+    std::mutex lock;
+    std::condition_variable room;
+
+public:
+    Reorder(int out, uint64_t chunks) : fd(out), window(chunks) {}
+
+    // blocks until chunk seq is within the window of the written ones
+    void wait_turn(uint64_t seq) {
+        std::unique_lock<std::mutex> guard(lock);
+        room.wait(guard, [&] { return seq < next + window; });
+    }
+
+    void put(uint64_t seq, std::string&& text) {
+        std::unique_lock<std::mutex> guard(lock);
+        ready.emplace(seq, std::move(text));
+        if (writing) return;
+        writing = true;
+        while (!ready.empty() && ready.begin()->first == next) {
+            std::string out = std::move(ready.begin()->second);
+            ready.erase(ready.begin());
+            guard.unlock();
+            bool ok = write_all(out.data(), out.size());
+            guard.lock();
+            error = error || !ok;
+            next++;
+            room.notify_all();
+        }
+        writing = false;
+    }
+
+    bool failed() const { return error; }
+
+private:
+    bool write_all(const char* p, size_t len) {
+        while (len > 0) {
+            ssize_t w = write(fd, p, len);
+            if (w < 0) return false;
+            p += w;
+            len -= static_cast<size_t>(w);
+        }
+        return true;
+    }
+};
+
+// the Fibonacci half of the test for odd n >= 3: F(n+1) for n == ±2 mod 5,
+// F(n-1) for n == ±1 mod 5, and among multiples of 5 only 5 itself passes
+template <typename T>
+bool lucas_condition(T n){
+    unsigned r = static_cast<unsigned>(n % 5);
+    if (r == 0) return n == 5;
+    return lucas_fib(MontgomeryT<T>(n), r == 2 || r == 3 ? n + 1 : n - 1) == 0;
+}
+
+// fermat, fib and verify over a batch of odd n >= 3, writing the outcome
+// of each lane through its tag
+template <typename T>
+void run(pipeline::Batch<T>& b, uint8_t* outcome, stats::WorkerStats& st){
+    static const pipeline::SieveMap<T> none;
+    static const stats::Stage order[] = {stats::fermat_stage, stats::fib_stage, stats::verify_stage};
+    static const Outcome rejected[] = {composite_fermat, composite_fib, prime};
+    stats::bump(st.tested, b.count);
+    b.keep_all();
+    for (int k = 0; k < 3 && b.count > 0; ++k) {
+        stats::Stage s = order[k];
+        size_t in = b.count;
+        uint64_t t0 = stats::now_ns();
+        if (s == stats::fib_stage) {
+            for (size_t i = 0; i < b.count; ++i) {
+                if (!lucas_condition(b.n[i])) b.reject(i);
+            }
+        }
+        else pipeline::run_stage(s, b, none);
+        for (size_t i = 0; i < b.count; ++i) {
+            if (!b.is_alive(i)) outcome[b.tag[i]] = rejected[k];
+        }
+        b.compact();
+        stats::bump(stats::stage_time(st, s), stats::now_ns() - t0);
+        stats::bump(st.stage_in[s], in);
+        stats::bump(st.stage_pass[s], b.count);
+        if (s == stats::fermat_stage) stats::bump(st.fermat_passes, b.count);
+        if (s == stats::fib_stage) stats::bump(st.fib_passes, b.count);
+        if (s == stats::verify_stage) stats::bump(st.verify_calls, in);
+    }
+    for (size_t i = 0; i < b.count; ++i) {
+        outcome[b.tag[i]] = b.n[i] % 5 == 2 || b.n[i] % 5 == 3 ? counterexample : pseudoprime;
+    }
+    b.count = 0;
+}
+
+// fills in the untested outcomes of values; the odd ones from 3 up go to
+// the kernels in batches of their width, the rest are settled here
+inline void test(const std::vector<uint128_t>& values, std::vector<uint8_t>& outcome, stats::WorkerStats& st){
+    pipeline::Batch<uint64_t> narrow;
+    pipeline::Batch<uint128_t> wide;
+    for (size_t i = 0; i < values.size(); ++i) {
+        uint128_t n = values[i];
+        if (outcome[i] != untested) continue;
+        if (n < 2) outcome[i] = invalid;
+        else if (n == 2) outcome[i] = prime;
+        else if (!(n & 1)) outcome[i] = composite_fermat;
+        else if (n >> 64 == 0) {
+            narrow.push(static_cast<uint64_t>(n), static_cast<uint32_t>(i));
+            if (narrow.count == pipeline::width) run(narrow, outcome.data(), st);
+        }
+        else {
+            wide.push(n, static_cast<uint32_t>(i));
+            if (wide.count == pipeline::width) run(wide, outcome.data(), st);
+        }
+    }
+    if (narrow.count > 0) run(narrow, outcome.data(), st);
+    if (wide.count > 0) run(wide, outcome.data(), st);
+}
+
+inline void append_number(std::string& out, uint128_t v){
+    if (v >> 64) {
+        out += to_string(v);
+        return;
+    }
+    char buf[20];
+    char* e = std::to_chars(buf, buf + sizeof(buf), static_cast<uint64_t>(v)).ptr;
+    out.append(buf, e);
+}
+
+// per-worker scratch, reused from chunk to chunk
+struct Scratch {
+    std::vector<uint128_t> values;
+    std::vector<uint8_t> outcome;
+    struct Token { size_t index; uint32_t offset, length; };
+    std::vector<Token> bad;     // the text of the invalid tokens
+};
+
+// splits a chunk into values, an invalid token keeps its place with
+// outcome invalid so its line can echo it
+inline void decode(const Chunk& c, bool binary, Scratch& s){
+    s.values.clear();
+    s.outcome.clear();
+    s.bad.clear();
+    if (binary) {
+        size_t count = c.length / 8;
+        s.values.resize(count);
+        s.outcome.assign(count, untested);
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t v;
+            memcpy(&v, c.data + 8 * i, 8);
+            s.values[i] = v;
+        }
+        return;
+    }
+    const char* p = c.data;
+    const char* end = c.data + c.length;
+    if (c.comment) {
+        while (p < end && *p != '\n') ++p;
+    }
+    while (p < end) {
+        char ch = *p;
+        if (is_space(ch)) {
+            ++p;
+            continue;
+        }
+        if (ch == '#') {
+            while (p < end && *p != '\n') ++p;
+            continue;
+        }
+        // digits until the next whitespace, any other byte (control, UTF-8)
+        // or 2^128 and up is invalid
+        const uint128_t top = ~static_cast<uint128_t>(0) / 10;
+        const char* t = p;
+        uint128_t v = 0;
+        bool ok = true;
+        for (; p < end && !is_space(*p); ++p) {
+            unsigned d = static_cast<unsigned>(static_cast<unsigned char>(*p)) - '0';
+            ok = ok && d < 10 && (v < top || (v == top && d <= 5));
+            v = v * 10 + d;
+        }
+        s.values.push_back(ok ? v : 0);
+        s.outcome.push_back(ok ? untested : invalid);
+        if (!ok) s.bad.push_back({s.values.size() - 1, static_cast<uint32_t>(t - c.data), static_cast<uint32_t>(p - t)});
+    }
+}
+
+// one "n outcome" line per value
+inline std::string format(const Chunk& c, const Scratch& s){
+    std::string out;
+    out.reserve(s.values.size() * 32);
+    size_t b = 0;
+    for (size_t i = 0; i < s.values.size(); ++i) {
+        if (b < s.bad.size() && s.bad[b].index == i) {
+            out.append(c.data + s.bad[b].offset, s.bad[b].length);
+            b++;
+        }
+        else append_number(out, s.values[i]);
+        out += ' ';
+        out += outcome_names[s.outcome[i]];
+        out += '\n';
+    }
+    return out;
+}
+
+} // namespace stream
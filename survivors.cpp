@@ -0,0 +1,46 @@
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "modarith.h"
+#include "catalogue.h"
+
+// lists the Fermat survivors a run of main --catalogue recorded in a
+// range, or only counts them with --count
+
+int main(int argc, char* argv[]){
+    if (argc < 2) {
+        std::cout << "usage: " << argv[0] << " catalogue [lo hi] [--count]" << std::endl;
+        return 1;
+    }
+    uint128_t lo = 0, hi = ~static_cast<uint128_t>(0);
+    bool count_only = std::string(argv[argc - 1]) == "--count";
+    int positional = argc - (count_only ? 1 : 0);
+    if (positional == 4 && (!parse_u128(argv[2], lo) || !parse_u128(argv[3], hi))) {
+        std::cout << "bad range " << argv[2] << " " << argv[3] << std::endl;
+        return 1;
+    }
+
+    catalogue::Reader reader;
+    if (!reader.open(argv[1])) {
+        std::cout << "could not open catalogue " << argv[1] << " (or it is from before the header checksum)" << std::endl;
+        return 1;
+    }
+    uint64_t total = 0, fib = 0, composite = 0;
+    bool intact = reader.for_each(lo, hi, [&](const catalogue::Entry& e) {
+        total++;
+        if (e.flags & catalogue::fib_pass) fib++;
+        if ((e.flags & catalogue::fib_pass) && !(e.flags & catalogue::prime)) composite++;
+        if (!count_only) {
+            std::cout << to_string(e.n) << ((e.flags & catalogue::fib_pass) ? " fib" : "")
+                      << ((e.flags & catalogue::fib_pass) && !(e.flags & catalogue::prime) ? " composite" : "") << "\n";
+        }
+    });
+    std::cout << total << " Fermat survivors, " << fib << " passing the Fibonacci test, "
+              << composite << " of those composite" << std::endl;
+    if (!intact) std::cout << "some blocks failed their checksum and were skipped" << std::endl;
+    return intact ? 0 : 1;
+}
+
+// LINUX COMPILE:
+// g++ survivors.cpp -o survivors -O3
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+
+// CPU and NUMA layout from sysfs, limited to the CPUs in our affinity mask
+// (so taskset/cgroup limits are honoured), and thread pinning
+// missing sysfs files degrade to one node with every CPU its own core
+
+namespace topology {
+
+struct Cpu {
+    unsigned cpu;      // logical CPU number
+    unsigned node;     // NUMA node
+    unsigned package;
+    unsigned core;     // core_id, unique only within a package
+    bool sibling;      // a second hardware thread of a core listed earlier
+};
+
+inline bool read_uint(const std::string& path, unsigned& out){
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return false;
+    bool ok = fscanf(f, "%u", &out) == 1;
+    fclose(f);
+    return ok;
+}
+
+// the nodeN entry sysfs puts in each cpu directory
+inline unsigned node_of(unsigned cpu){
+    std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* d = opendir(dir.c_str());
+    if (!d) return 0;
+    unsigned node = 0;
+    while (dirent* e = readdir(d)) {
+        unsigned n;
+        if (strncmp(e->d_name, "node", 4) == 0 && sscanf(e->d_name + 4, "%u", &n) == 1) {
+            node = n;
+            break;
+        }
+    }
+    closedir(d);
+    return node;
+}
+
+inline std::vector<Cpu> discover(){
+    std::vector<Cpu> cpus;
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (sched_getaffinity(0, sizeof(mask), &mask) != 0) return cpus;
+
+    std::map<std::pair<unsigned, unsigned>, unsigned> seen; // (package, core) -> first cpu
+    for (unsigned c = 0; c < CPU_SETSIZE; ++c) {
+        if (!CPU_ISSET(c, &mask)) continue;
+        std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(c) + "/topology/";
+        Cpu cpu = {c, node_of(c), 0, c, false};
+        read_uint(base + "physical_package_id", cpu.package);
+        read_uint(base + "core_id", cpu.core);
+        auto key = std::make_pair(cpu.package, cpu.core);
+        cpu.sibling = seen.count(key) > 0;
+        if (!cpu.sibling) seen[key] = c;
+        cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+inline unsigned count_nodes(const std::vector<Cpu>& cpus){
+    unsigned nodes = 0;
+    for (const Cpu& c : cpus) nodes = std::max(nodes, c.node + 1);
+    return nodes;
+}
+
+// order to hand CPUs to workers: one thread per physical core first,
+// alternating between nodes so a partial run still uses every memory
+// controller, then the SMT siblings unless they are skipped
+inline std::vector<Cpu> placement(const std::vector<Cpu>& cpus, bool skip_smt){
+    std::vector<Cpu> order;
+    for (int pass = 0; pass < 2; ++pass) {
+        if (pass == 1 && skip_smt) break;
+        std::vector<std::vector<Cpu>> per_node(count_nodes(cpus));
+        for (const Cpu& c : cpus) {
+            if (c.sibling == (pass == 1)) per_node[c.node].push_back(c);
+        }
+        for (size_t i = 0; ; ++i) {
+            bool any = false;
+            for (const auto& node : per_node) {
+                if (i < node.size()) {
+                    order.push_back(node[i]);
+                    any = true;
+                }
+            }
+            if (!any) break;
+        }
+    }
+    return order;
+}
+
+inline bool pin_to(unsigned cpu){
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+} // namespace topology
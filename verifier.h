@@ -0,0 +1,180 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+// verification off the search threads: workers hand the survivors of
+// the fast tests to a pool through a bounded lock-free queue and go on
+// with the next batch; a full queue is the worker's cue to verify that
+// one itself, so it never waits on the pool
+//
+// the pool starts every thread it may use but keeps all except `active`
+// of them parked; a manager wakes another one while the queue backs up
+// and parks one after the queue has been empty for a second
+
+namespace verifier {
+
+// bounded multi-producer multi-consumer ring, after Vyukov: each cell's
+// sequence number says whether it is free for the push of that lap or
+// holds a value for its pop, so both ends only ever CAS their position
+template <typename T>
+class BoundedQueue {
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(64) std::atomic<size_t> tail;   // next push
+    alignas(64) std::atomic<size_t> head;   // next pop
+
+public:
+    // capacity is rounded up to a power of two
+    explicit BoundedQueue(size_t capacity) : tail(0), head(0) {
+        size_t size = 2;
+        while (size < capacity) size *= 2;
+        cells.reset(new Cell[size]);
+        mask = size - 1;
+        for (size_t i = 0; i < size; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    bool try_push(const T& v) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& c = cells[pos & mask];
+            intptr_t diff = static_cast<intptr_t>(c.seq.load(std::memory_order_acquire)) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    c.value = v;
+                    c.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) return false;    // full
+            else pos = tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    bool try_pop(T& v) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& c = cells[pos & mask];
+            intptr_t diff = static_cast<intptr_t>(c.seq.load(std::memory_order_acquire)) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    v = c.value;
+                    c.seq.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) return false;    // empty
+            else pos = head.load(std::memory_order_relaxed);
+        }
+    }
+
+    size_t capacity() const { return mask + 1; }
+    uint64_t pushed() const { return tail.load(std::memory_order_relaxed); }
+
+    // a moment's view, may be off by the operations in flight
+    size_t depth() const {
+        size_t t = tail.load(std::memory_order_relaxed), h = head.load(std::memory_order_relaxed);
+        return t > h ? t - h : 0;
+    }
+};
+
+template <typename Job>
+class Pool {
+public:
+    // handle(id, job) runs on pool thread id, 0 <= id < max_threads
+    typedef std::function<void(unsigned, Job&)> Handler;
+
+private:
+    BoundedQueue<Job> queue;
+    Handler handle;
+    unsigned max_threads;
+    std::atomic<unsigned> active;
+    std::atomic<uint64_t> handled;
+    std::atomic_bool stopping;
+    std::vector<std::thread> threads;
+    std::thread manager;
+
+public:
+    Pool(size_t capacity, unsigned threads_max, Handler h)
+        : queue(capacity), handle(h), max_threads(threads_max < 1 ? 1 : threads_max),
+          active(1), handled(0), stopping(false) {
+        for (unsigned i = 0; i < max_threads; ++i) threads.emplace_back(&Pool::run, this, i);
+        manager = std::thread(&Pool::manage, this);
+    }
+
+    Pool(const Pool&) = delete;
+    Pool& operator=(const Pool&) = delete;
+
+    // drain() first, jobs still queued here are dropped
+    ~Pool() {
+        stopping = true;
+        manager.join();
+        for (auto& t : threads) t.join();
+    }
+
+    // false when the queue is full, the caller does the job itself
+    bool try_push(const Job& j) { return queue.try_push(j); }
+
+    // returns once every job pushed so far has been handled
+    void drain() {
+        active = max_threads;
+        while (handled.load() < queue.pushed()) usleep(1000);
+    }
+
+    size_t depth() const { return queue.depth(); }
+    size_t capacity() const { return queue.capacity(); }
+    uint64_t backlog() const { return queue.pushed() - handled.load(); }  // queued or running
+    unsigned threads_active() const { return active.load(); }
+    unsigned threads_max() const { return max_threads; }
+
+private:
+    void run(unsigned id) {
+        Job j;
+        while (!stopping) {
+            if (id >= active.load(std::memory_order_relaxed)) {
+                usleep(10000);
+                continue;
+            }
+            if (!queue.try_pop(j)) {
+                usleep(200);
+                continue;
+            }
+            handle(id, j);
+            handled.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    // every 50 ms: one more thread while an eighth of the queue is in use,
+    // one fewer after 20 looks at an empty queue
+    void manage() {
+        unsigned idle = 0;
+        while (!stopping) {
+            usleep(50000);
+            size_t d = queue.depth();
+            unsigned a = active.load();
+            idle = d == 0 ? idle + 1 : 0;
+            if (d > queue.capacity() / 8 && a < max_threads) active = a + 1;
+            else if (idle >= 20 && a > 1) {
+                active = a - 1;
+                idle = 0;
+            }
+        }
+    }
+};
+
+} // namespace verifier
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "modarith.h"
+
+// candidate generator over a wheel of 2*3*5*7*11 = 2310
+// a residue r mod 2310 is kept when n == r can be a counterexample:
+//   n odd and n == ±2 mod 5 (the conjecture's hypothesis)
+//   11 | n is impossible: ord_11(2) = 10 | n-1 forces n == 1 mod 5
+//   7 | n needs ord_7(2) = 3 | n-1, so n == 1 mod 3
+// (3 | n stays, z(3) = 4 | n+1 depends on n mod 4 which the wheel cannot see)
+// which leaves 380 of the 2310 residues; the tables are built at compile
+// time and checked against a derivation from the orders further down
+
+namespace wheel {
+
+const uint32_t modulus = 2310;
+const uint32_t count = 380;
+
+constexpr bool admissible(uint32_t r){
+    return r % 2 == 1 && (r % 5 == 2 || r % 5 == 3) && r % 11 != 0 && !(r % 7 == 0 && r % 3 != 1);
+}
+
+struct Table {
+    uint16_t residue[count];
+    uint16_t next[modulus];  // index of the first residue >= r, count when none
+};
+
+constexpr Table make_table(){
+    Table t = {};
+    uint32_t k = 0;
+    for (uint32_t r = 0; r < modulus; ++r) {
+        if (admissible(r) && k < count) t.residue[k++] = static_cast<uint16_t>(r);
+    }
+    for (uint32_t r = modulus, i = count; r-- > 0; ) {
+        if (i > 0 && t.residue[i - 1] == r) --i;
+        t.next[r] = static_cast<uint16_t>(i);
+    }
+    return t;
+}
+
+constexpr Table table = make_table();
+
+// exhaustive check of every residue from first principles: for each wheel
+// prime q dividing r, whichever of ord_q(2) | n-1 and z(q) | n+1 can be
+// decided mod 2310 must hold, and n must be odd and ±2 mod 5
+constexpr uint32_t order2(uint32_t q){
+    uint32_t k = 1, x = 2 % q;
+    while (x != 1) { x = x * 2 % q; ++k; }
+    return k;
+}
+
+constexpr uint32_t fib_rank(uint32_t q){
+    uint32_t a = 0, b = 1, k = 0;
+    do { uint32_t t = (a + b) % q; a = b; b = t; ++k; } while (a != 0);
+    return k;
+}
+
+constexpr bool derived_admissible(uint32_t r){
+    if (r % 2 == 0 || (r % 5 != 2 && r % 5 != 3)) return false;
+    const uint32_t primes[] = {3, 7, 11};
+    for (uint32_t q : primes) {
+        if (r % q != 0) continue;
+        uint32_t ord = order2(q), z = fib_rank(q);
+        if (modulus % ord == 0 && (r + modulus - 1) % ord != 0) return false;
+        if (modulus % z == 0 && (r + 1) % z != 0) return false;
+    }
+    return true;
+}
+
+constexpr bool check_table(){
+    uint32_t k = 0;
+    for (uint32_t r = 0; r < modulus; ++r) {
+        if (admissible(r) != derived_admissible(r)) return false;
+        if (admissible(r)) {
+            if (k >= count || table.residue[k] != r) return false;
+            ++k;
+        }
+        // seek lands on the first admissible residue at or after r
+        uint32_t i = table.next[r];
+        if (i < count && (table.residue[i] < r || (i > 0 && table.residue[i - 1] >= r))) return false;
+        if (i == count && table.residue[count - 1] >= r) return false;
+    }
+    return k == count;
+}
+
+static_assert(order2(7) == 3 && order2(11) == 10 && fib_rank(3) == 4 && fib_rank(11) == 10, "wheel orders");
+static_assert(check_table(), "wheel residues do not match their derivation");
+
+// walks the admissible numbers in increasing order, T is uint64_t or uint128_t
+template <typename T>
+class Iterator {
+private:
+    T base;        // multiple of the modulus
+    uint32_t idx;  // position in table.residue
+
+public:
+    explicit Iterator(T start) { seek(start); }
+
+    // O(1): position on the first admissible number >= x
+    void seek(T x) {
+        base = x - x % modulus;
+        idx = table.next[static_cast<uint32_t>(x % modulus)];
+    }
+
+    // up to max admissible numbers below hi into out, returns how many;
+    // 0 once the iterator has passed hi
+    size_t fill(T* out, size_t max, T hi) {
+        size_t n = 0;
+        while (n < max) {
+            if (idx == count) {
+                if (base >= hi || hi - base <= modulus) break; // next turn starts at or past hi
+                base += modulus;
+                idx = 0;
+            }
+            if (base >= hi || table.residue[idx] >= hi - base) break;
+            out[n++] = base + table.residue[idx++];
+        }
+        return n;
+    }
+};
+
+} // namespace wheel